@@ -0,0 +1,345 @@
+#include <postgres.h>
+#include <fmgr.h>
+#include <math.h>
+
+#include <access/detoast.h>
+#include <common/hashfn.h>
+#include <libpq/pqformat.h>
+#include <utils/builtins.h>
+#include <utils/memutils.h>
+
+#include "bitcoin_address.h"
+#include "soft_error.h"
+
+
+/*
+ * A split-block Bloom filter of a set of addresses. Each address is hashed from its packed representation. The upper 32 bits of
+ * the 64-bit hash select a block of eight 32-bit words, and the lower 32 bits, multiplied by a different odd salt for each word,
+ * select one bit to set in each word. A membership test therefore touches a single 32-byte block.
+ *
+ * The aggregate collects the hashes of its inputs and sizes the filter for their number and the requested false-positive rate
+ * only at the end, taking into account the uneven distribution of hashes among blocks. The stored address_bloom type consists of
+ * a format byte, three reserved bytes, the number of blocks, and the blocks. Its bits are incompressible, so it is stored
+ * uncompressed.
+ */
+#define BLOOM_FORMAT 1
+#define BLOOM_BLOCK_WORDS 8
+
+struct address_bloom {
+	char vl_len_[4]; // varlena header
+	uint8 format;
+	uint8 reserved[3];
+	uint32 n_blocks;
+	uint32 blocks[FLEXIBLE_ARRAY_MEMBER][BLOOM_BLOCK_WORDS];
+};
+
+#define ADDRESS_BLOOM_SIZE(n_blocks) (offsetof(struct address_bloom, blocks) + (size_t) (n_blocks) * BLOOM_BLOCK_WORDS * sizeof(uint32))
+#define BLOOM_MAX_BLOCKS ((MaxAllocSize - offsetof(struct address_bloom, blocks)) / (BLOOM_BLOCK_WORDS * sizeof(uint32)))
+
+static const uint32 bloom_salts[BLOOM_BLOCK_WORDS] = {
+	0x47B6137B, 0x44974D91, 0x8824AD5B, 0xA2B7289D, 0x705495C7, 0x2DF1424B, 0x9EFC4947, 0x5C6BFB31,
+};
+
+static inline uint64
+address_hash(const bitcoin_address *arg)
+{
+	return DatumGetUInt64(hash_any_extended((const unsigned char *) VARDATA_ANY(arg), (int) VARSIZE_ANY_EXHDR(arg), 0));
+}
+
+static inline size_t
+bloom_block_idx(const struct address_bloom *filter, uint64 hash)
+{
+	return (hash >> 32) * filter->n_blocks >> 32;
+}
+
+static inline void
+bloom_insert(struct address_bloom *filter, uint64 hash)
+{
+	uint32 *block = filter->blocks[bloom_block_idx(filter, hash)];
+	for (size_t i = 0; i < BLOOM_BLOCK_WORDS; ++i)
+		block[i] |= (uint32) 1 << ((uint32) hash * bloom_salts[i] >> 27);
+}
+
+static inline bool
+bloom_contains(const struct address_bloom *filter, uint64 hash)
+{
+	const uint32 *block = filter->blocks[bloom_block_idx(filter, hash)];
+	uint32 missing = 0;
+	for (size_t i = 0; i < BLOOM_BLOCK_WORDS; ++i)
+		missing |= ~block[i] & (uint32) 1 << ((uint32) hash * bloom_salts[i] >> 27);
+	return !missing;
+}
+
+/*
+ * Returns the false-positive rate of a filter whose blocks hold lambda hashes on average. The number of hashes in a block is
+ * Poisson-distributed, and a test of an absent address fails only if the bit it selects in each of the words is set.
+ */
+static double __attribute__ ((__const__))
+bloom_fp_rate(double lambda)
+{
+	double sum = 0.0, log_p = -lambda; // logarithm of the Poisson probability of k hashes in a block
+	for (double k = 0.0, k_max = lambda + 12.0 * sqrt(lambda) + 12.0; k <= k_max; ++k) {
+		if (k > 0.0)
+			log_p += log(lambda) - log(k);
+		sum += exp(log_p) * pow(-expm1(k * log1p(-1.0 / 32)), BLOOM_BLOCK_WORDS);
+	}
+	return sum;
+}
+
+// returns the least number of blocks that holds n_hashes hashes with at most the given false-positive rate
+static size_t
+bloom_n_blocks(size_t n_hashes, double fp_rate)
+{
+	if (n_hashes == 0)
+		return 1;
+	if (_unlikely(bloom_fp_rate((double) n_hashes / (double) BLOOM_MAX_BLOCKS) > fp_rate))
+		ereport(ERROR, errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				errmsg("address_bloom would be too large"),
+				errdetail("A filter of %zu addresses with a false-positive rate of %g would exceed the maximum size.",
+						n_hashes, fp_rate));
+	size_t lo = 1, hi = BLOOM_MAX_BLOCKS;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (bloom_fp_rate((double) n_hashes / (double) mid) <= fp_rate)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+// returns a description of the problem with a filter that completes the sentence "The address_bloom ...", or NULL if it is valid
+static const char *
+check_address_bloom(const struct varlena *arg)
+{
+	if (VARSIZE_ANY(arg) < ADDRESS_BLOOM_SIZE(1))
+		return "is too short";
+	const struct address_bloom *filter = (const struct address_bloom *) arg;
+	if (filter->format != BLOOM_FORMAT)
+		return "uses an unsupported format";
+	if (filter->n_blocks == 0 || VARSIZE_ANY(arg) != ADDRESS_BLOOM_SIZE(filter->n_blocks))
+		return "has the wrong size";
+	return NULL;
+}
+
+static const struct address_bloom *
+checked_address_bloom(const struct varlena *arg)
+{
+	const char *problem = check_address_bloom(arg);
+	if (_unlikely(problem))
+		ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				errmsg("stored address_bloom %s", problem));
+	return (const struct address_bloom *) arg;
+}
+
+/*
+ * A filter is typically a constant or comes from a single stored row, and it may be large. A filter that is stored out of line is
+ * fetched only once per call site and kept in fn_extra, keyed on its TOAST pointer, which identifies it uniquely.
+ */
+struct bloom_cache {
+	struct varatt_external pointer;
+	struct varlena *filter; // detoasted and checked
+};
+
+static const struct address_bloom *
+getarg_address_bloom(FunctionCallInfo fcinfo, int n)
+{
+	struct varlena *arg = (struct varlena *) PG_GETARG_POINTER(n);
+	if (!VARATT_IS_EXTERNAL_ONDISK(arg))
+		return checked_address_bloom(PG_DETOAST_DATUM(PG_GETARG_DATUM(n)));
+
+	struct varatt_external pointer;
+	VARATT_EXTERNAL_GET_POINTER(pointer, arg);
+	struct bloom_cache *cache = fcinfo->flinfo->fn_extra;
+	if (_likely(cache) && memcmp(&cache->pointer, &pointer, sizeof pointer) == 0)
+		return (const struct address_bloom *) cache->filter;
+	if (!cache)
+		fcinfo->flinfo->fn_extra = cache = MemoryContextAllocZero(fcinfo->flinfo->fn_mcxt, sizeof *cache);
+	else if (cache->filter)
+		pfree(cache->filter), cache->filter = NULL;
+	MemoryContext oldcontext = MemoryContextSwitchTo(fcinfo->flinfo->fn_mcxt);
+	struct varlena *data = detoast_attr(arg); // also decompresses the filter if it was stored compressed
+	MemoryContextSwitchTo(oldcontext);
+	const struct address_bloom *filter = checked_address_bloom(data);
+	cache->pointer = pointer;
+	cache->filter = data;
+	return filter;
+}
+
+
+PG_FUNCTION_INFO_V1(pg_address_bloom_input);
+Datum
+pg_address_bloom_input(PG_FUNCTION_ARGS)
+{
+	const struct varlena *out = DatumGetByteaP(DirectFunctionCall1(byteain, PG_GETARG_DATUM(0)));
+	const char *problem = check_address_bloom(out);
+	if (_unlikely(problem))
+		ereturn(fcinfo->context, (Datum) 0, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+				errmsg("address_bloom %s", problem));
+	PG_RETURN_POINTER(out);
+}
+
+PG_FUNCTION_INFO_V1(pg_address_bloom_output);
+Datum
+pg_address_bloom_output(PG_FUNCTION_ARGS)
+{
+	return DirectFunctionCall1(byteaout, PG_GETARG_DATUM(0));
+}
+
+PG_FUNCTION_INFO_V1(pg_address_bloom_receive);
+Datum
+pg_address_bloom_receive(PG_FUNCTION_ARGS)
+{
+	StringInfo buf = (StringInfo) PG_GETARG_POINTER(0);
+	size_t n_data = (size_t) (buf->len - buf->cursor);
+	struct varlena *out = palloc(VARHDRSZ + n_data);
+	SET_VARSIZE(out, VARHDRSZ + n_data);
+	pq_copymsgbytes(buf, VARDATA(out), (int) n_data);
+	const char *problem = check_address_bloom(out);
+	if (_unlikely(problem))
+		ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				errmsg("received address_bloom %s", problem));
+	PG_RETURN_POINTER(out);
+}
+
+PG_FUNCTION_INFO_V1(pg_address_bloom_send);
+Datum
+pg_address_bloom_send(PG_FUNCTION_ARGS)
+{
+	return DirectFunctionCall1(byteasend, PG_GETARG_DATUM(0));
+}
+
+PG_FUNCTION_INFO_V1(pg_bloom_may_contain);
+Datum
+pg_bloom_may_contain(PG_FUNCTION_ARGS)
+{
+	const struct address_bloom *filter = getarg_address_bloom(fcinfo, 0);
+	PG_RETURN_BOOL(bloom_contains(filter, address_hash(PG_GETARG_VARLENA_PP(1))));
+}
+
+
+/*
+ * The transition state of the aggregate is the requested false-positive rate and the hashes of the addresses seen so far. Its
+ * serialized form is the false-positive rate followed by the hashes, all in host byte order, which suffices between the processes
+ * of a parallel query.
+ */
+struct bloom_state {
+	double fp_rate;
+	size_t n_hashes, capacity;
+	uint64 *hashes;
+};
+
+static struct bloom_state *
+bloom_state_create(MemoryContext aggcontext, double fp_rate, size_t capacity)
+{
+	struct bloom_state *state = MemoryContextAlloc(aggcontext, sizeof *state);
+	state->fp_rate = fp_rate;
+	state->n_hashes = 0;
+	state->capacity = Max(capacity, 64);
+	state->hashes = MemoryContextAllocHuge(aggcontext, state->capacity * sizeof *state->hashes);
+	return state;
+}
+
+static void
+bloom_state_reserve(struct bloom_state *state, size_t n)
+{
+	if (state->n_hashes + n > state->capacity) {
+		state->capacity = Max(state->capacity * 2, state->n_hashes + n);
+		state->hashes = repalloc_huge(state->hashes, state->capacity * sizeof *state->hashes);
+	}
+}
+
+static MemoryContext
+aggregate_context(FunctionCallInfo fcinfo, const char *funcname)
+{
+	MemoryContext aggcontext;
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "%s called in non-aggregate context", funcname);
+	return aggcontext;
+}
+
+PG_FUNCTION_INFO_V1(pg_address_bloom_add);
+Datum
+pg_address_bloom_add(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext = aggregate_context(fcinfo, "address_bloom_add");
+	struct bloom_state *state = PG_ARGISNULL(0) ? NULL : (struct bloom_state *) PG_GETARG_POINTER(0);
+	if (!state) {
+		if (PG_ARGISNULL(2))
+			ereport(ERROR, errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+					errmsg("false-positive rate must not be null"));
+		double fp_rate = PG_GETARG_FLOAT8(2);
+		if (!(fp_rate > 0.0 && fp_rate < 1.0))
+			ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					errmsg("false-positive rate must be between 0 and 1 exclusive"));
+		state = bloom_state_create(aggcontext, fp_rate, 0);
+	}
+	if (!PG_ARGISNULL(1)) {
+		bloom_state_reserve(state, 1);
+		state->hashes[state->n_hashes++] = address_hash(PG_GETARG_VARLENA_PP(1));
+	}
+	PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(pg_address_bloom_combine);
+Datum
+pg_address_bloom_combine(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext = aggregate_context(fcinfo, "address_bloom_combine");
+	struct bloom_state *state = PG_ARGISNULL(0) ? NULL : (struct bloom_state *) PG_GETARG_POINTER(0);
+	const struct bloom_state *other = PG_ARGISNULL(1) ? NULL : (const struct bloom_state *) PG_GETARG_POINTER(1);
+	if (!other) {
+		if (!state)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
+	}
+	if (!state)
+		state = bloom_state_create(aggcontext, other->fp_rate, other->n_hashes);
+	bloom_state_reserve(state, other->n_hashes);
+	memcpy(&state->hashes[state->n_hashes], other->hashes, other->n_hashes * sizeof *other->hashes);
+	state->n_hashes += other->n_hashes;
+	PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(pg_address_bloom_serialize);
+Datum
+pg_address_bloom_serialize(PG_FUNCTION_ARGS)
+{
+	const struct bloom_state *state = (const struct bloom_state *) PG_GETARG_POINTER(0);
+	size_t n_out = VARHDRSZ + sizeof state->fp_rate + state->n_hashes * sizeof *state->hashes;
+	bytea *out = palloc(n_out);
+	SET_VARSIZE(out, n_out);
+	memcpy(VARDATA(out), &state->fp_rate, sizeof state->fp_rate);
+	memcpy(VARDATA(out) + sizeof state->fp_rate, state->hashes, state->n_hashes * sizeof *state->hashes);
+	PG_RETURN_BYTEA_P(out);
+}
+
+PG_FUNCTION_INFO_V1(pg_address_bloom_deserialize);
+Datum
+pg_address_bloom_deserialize(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext = aggregate_context(fcinfo, "address_bloom_deserialize");
+	const bytea *arg = PG_GETARG_BYTEA_PP(0);
+	double fp_rate;
+	memcpy(&fp_rate, VARDATA_ANY(arg), sizeof fp_rate);
+	size_t n_hashes = (VARSIZE_ANY_EXHDR(arg) - sizeof fp_rate) / sizeof(uint64);
+	struct bloom_state *state = bloom_state_create(aggcontext, fp_rate, n_hashes);
+	memcpy(state->hashes, VARDATA_ANY(arg) + sizeof fp_rate, n_hashes * sizeof *state->hashes);
+	state->n_hashes = n_hashes;
+	PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(pg_address_bloom_final);
+Datum
+pg_address_bloom_final(PG_FUNCTION_ARGS)
+{
+	const struct bloom_state *state = (const struct bloom_state *) PG_GETARG_POINTER(0);
+	size_t n_blocks = bloom_n_blocks(state->n_hashes, state->fp_rate);
+	struct address_bloom *out = palloc0(ADDRESS_BLOOM_SIZE(n_blocks));
+	SET_VARSIZE(out, ADDRESS_BLOOM_SIZE(n_blocks));
+	out->format = BLOOM_FORMAT;
+	out->n_blocks = (uint32) n_blocks;
+	for (size_t i = 0; i < state->n_hashes; ++i)
+		bloom_insert(out, state->hashes[i]);
+	PG_RETURN_POINTER(out);
+}
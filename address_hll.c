@@ -0,0 +1,254 @@
+#include <postgres.h>
+#include <fmgr.h>
+#include <math.h>
+
+#include <common/hashfn.h>
+#include <libpq/pqformat.h>
+#include <utils/builtins.h>
+
+#include "bitcoin_address.h"
+#include "soft_error.h"
+
+
+/*
+ * A HyperLogLog sketch of a set of addresses. Each address is hashed from its packed representation, so no textual encoding is
+ * involved, and equal addresses always hash alike. The upper HLL_PRECISION bits of the 64-bit hash select a register, and the
+ * register keeps the greatest rank (one plus the number of leading zero bits) of the remaining bits seen so far.
+ *
+ * The aggregates keep their transition state as a bare array of registers. The stored address_hll type, which is also the
+ * serialized form of the transition state, consists of a format byte, a precision byte, and the registers. The registers are
+ * stored densely; a sketch of few addresses is mostly zeros, which TOAST compresses well.
+ */
+#define HLL_FORMAT 1
+#define HLL_PRECISION 14 // standard error of about 0.8%
+#define HLL_REGISTERS (1 << HLL_PRECISION)
+#define HLL_MAX_RANK (64 - HLL_PRECISION + 1)
+
+struct address_hll {
+	char vl_len_[4]; // varlena header
+	uint8 format;
+	uint8 precision;
+	uint8 registers[HLL_REGISTERS];
+};
+
+#define ADDRESS_HLL_SIZE (VARHDRSZ + 2/*format and precision*/ + HLL_REGISTERS)
+StaticAssertDecl(sizeof(struct address_hll) == ADDRESS_HLL_SIZE, "struct address_hll must not be padded");
+
+struct hll_state {
+	uint8 registers[HLL_REGISTERS];
+};
+
+static inline void
+hll_add_hash(struct hll_state *state, uint64 hash)
+{
+	size_t idx = hash >> (64 - HLL_PRECISION);
+	uint64 rest = hash << HLL_PRECISION;
+	uint8 rank = rest ? (uint8) (__builtin_clzll(rest) + 1) : HLL_MAX_RANK;
+	if (rank > state->registers[idx])
+		state->registers[idx] = rank;
+}
+
+static inline void
+hll_merge(struct hll_state *restrict state, const uint8 *restrict registers)
+{
+	for (size_t i = 0; i < HLL_REGISTERS; ++i)
+		state->registers[i] = Max(state->registers[i], registers[i]);
+}
+
+static int64 __attribute__ ((__pure__))
+hll_estimate(const uint8 *registers)
+{
+	double sum = 0.0;
+	size_t n_zeros = 0;
+	for (size_t i = 0; i < HLL_REGISTERS; ++i) {
+		sum += ldexp(1.0, -registers[i]);
+		n_zeros += registers[i] == 0;
+	}
+	const double m = HLL_REGISTERS;
+	double estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+	if (estimate <= 2.5 * m && n_zeros) // linear counting is more accurate for small cardinalities
+		estimate = m * log(m / (double) n_zeros);
+	return (int64) (estimate + 0.5);
+}
+
+// returns a description of the problem with a sketch that completes the sentence "The address_hll ...", or NULL if it is valid
+static const char *
+check_address_hll(const struct varlena *arg)
+{
+	if (VARSIZE_ANY(arg) != ADDRESS_HLL_SIZE)
+		return "has the wrong size";
+	const struct address_hll *hll = (const struct address_hll *) arg;
+	if (hll->format != HLL_FORMAT)
+		return "uses an unsupported format";
+	if (hll->precision != HLL_PRECISION)
+		return "uses an unsupported precision";
+	for (size_t i = 0; i < HLL_REGISTERS; ++i)
+		if (hll->registers[i] > HLL_MAX_RANK)
+			return "is corrupted";
+	return NULL;
+}
+
+static const struct address_hll *
+getarg_address_hll(FunctionCallInfo fcinfo, int n)
+{
+	const struct varlena *arg = PG_GETARG_VARLENA_P(n);
+	const char *problem = check_address_hll(arg);
+	if (_unlikely(problem))
+		ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				errmsg("stored address_hll %s", problem));
+	return (const struct address_hll *) arg;
+}
+
+static struct address_hll *
+form_address_hll(const struct hll_state *state)
+{
+	struct address_hll *out = palloc(ADDRESS_HLL_SIZE);
+	SET_VARSIZE(out, ADDRESS_HLL_SIZE);
+	out->format = HLL_FORMAT;
+	out->precision = HLL_PRECISION;
+	if (state)
+		memcpy(out->registers, state->registers, HLL_REGISTERS);
+	else
+		memset(out->registers, 0, HLL_REGISTERS);
+	return out;
+}
+
+static struct hll_state *
+aggregate_state(FunctionCallInfo fcinfo, const char *funcname)
+{
+	MemoryContext aggcontext;
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "%s called in non-aggregate context", funcname);
+	return PG_ARGISNULL(0) ? MemoryContextAllocZero(aggcontext, sizeof(struct hll_state)) :
+			(struct hll_state *) PG_GETARG_POINTER(0);
+}
+
+
+PG_FUNCTION_INFO_V1(pg_address_hll_input);
+Datum
+pg_address_hll_input(PG_FUNCTION_ARGS)
+{
+	const struct varlena *out = DatumGetByteaPP(DirectFunctionCall1(byteain, PG_GETARG_DATUM(0)));
+	const char *problem = check_address_hll(out);
+	if (_unlikely(problem))
+		ereturn(fcinfo->context, (Datum) 0, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+				errmsg("address_hll %s", problem));
+	PG_RETURN_POINTER(out);
+}
+
+PG_FUNCTION_INFO_V1(pg_address_hll_output);
+Datum
+pg_address_hll_output(PG_FUNCTION_ARGS)
+{
+	return DirectFunctionCall1(byteaout, PG_GETARG_DATUM(0));
+}
+
+PG_FUNCTION_INFO_V1(pg_address_hll_receive);
+Datum
+pg_address_hll_receive(PG_FUNCTION_ARGS)
+{
+	StringInfo buf = (StringInfo) PG_GETARG_POINTER(0);
+	size_t n_data = (size_t) (buf->len - buf->cursor);
+	struct varlena *out = palloc(VARHDRSZ + n_data);
+	SET_VARSIZE(out, VARHDRSZ + n_data);
+	pq_copymsgbytes(buf, VARDATA(out), (int) n_data);
+	const char *problem = check_address_hll(out);
+	if (_unlikely(problem))
+		ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				errmsg("received address_hll %s", problem));
+	PG_RETURN_POINTER(out);
+}
+
+PG_FUNCTION_INFO_V1(pg_address_hll_send);
+Datum
+pg_address_hll_send(PG_FUNCTION_ARGS)
+{
+	return DirectFunctionCall1(byteasend, PG_GETARG_DATUM(0));
+}
+
+PG_FUNCTION_INFO_V1(pg_address_hll_cardinality);
+Datum
+pg_address_hll_cardinality(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_INT64(hll_estimate(getarg_address_hll(fcinfo, 0)->registers));
+}
+
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_hll_add);
+Datum
+pg_bitcoin_address_hll_add(PG_FUNCTION_ARGS)
+{
+	if (PG_ARGISNULL(1)) {
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_DATUM(PG_GETARG_DATUM(0));
+	}
+	struct hll_state *state = aggregate_state(fcinfo, "bitcoin_address_hll_add");
+	const bitcoin_address *arg = PG_GETARG_VARLENA_PP(1);
+	hll_add_hash(state, DatumGetUInt64(hash_any_extended((const unsigned char *) VARDATA_ANY(arg),
+			(int) VARSIZE_ANY_EXHDR(arg), 0)));
+	PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(pg_address_hll_union_add);
+Datum
+pg_address_hll_union_add(PG_FUNCTION_ARGS)
+{
+	if (PG_ARGISNULL(1)) {
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_DATUM(PG_GETARG_DATUM(0));
+	}
+	struct hll_state *state = aggregate_state(fcinfo, "address_hll_union_add");
+	hll_merge(state, getarg_address_hll(fcinfo, 1)->registers);
+	PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(pg_address_hll_combine);
+Datum
+pg_address_hll_combine(PG_FUNCTION_ARGS)
+{
+	if (PG_ARGISNULL(1)) {
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_DATUM(PG_GETARG_DATUM(0));
+	}
+	struct hll_state *state = aggregate_state(fcinfo, "address_hll_combine");
+	hll_merge(state, ((const struct hll_state *) PG_GETARG_POINTER(1))->registers);
+	PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(pg_address_hll_serialize);
+Datum
+pg_address_hll_serialize(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_POINTER(form_address_hll((const struct hll_state *) PG_GETARG_POINTER(0)));
+}
+
+PG_FUNCTION_INFO_V1(pg_address_hll_deserialize);
+Datum
+pg_address_hll_deserialize(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "address_hll_deserialize called in non-aggregate context");
+	struct hll_state *state = MemoryContextAlloc(aggcontext, sizeof(struct hll_state));
+	memcpy(state->registers, getarg_address_hll(fcinfo, 0)->registers, HLL_REGISTERS);
+	PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(pg_address_hll_final);
+Datum
+pg_address_hll_final(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_POINTER(form_address_hll((const struct hll_state *) PG_GETARG_POINTER(0)));
+}
+
+PG_FUNCTION_INFO_V1(pg_address_hll_final_cardinality);
+Datum
+pg_address_hll_final_cardinality(PG_FUNCTION_ARGS)
+{
+	if (PG_ARGISNULL(0))
+		PG_RETURN_INT64(0);
+	PG_RETURN_INT64(hll_estimate(((const struct hll_state *) PG_GETARG_POINTER(0))->registers));
+}
@@ -3,13 +3,49 @@
 #if HAVE_VARATT_H
 # include <varatt.h>
 #endif
+#include <common/hashfn.h>
+#include <libpq/pqformat.h>
+#include <utils/memutils.h>
 
 #include <base58check.h>
 
+#include "base58check21.h"
+#include "base58check_scratch.h"
+#include "soft_error.h"
+
 #define _likely(...) __builtin_expect(!!(__VA_ARGS__), 1)
 #define _unlikely(...) __builtin_expect(!!(__VA_ARGS__), 0)
 
 
+/*
+ * These wrap the functions of libbase58check having the same signatures, diverting payloads of the size of a typical legacy
+ * Bitcoin address to the specialized codec.
+ */
+static ssize_t
+fast_base58check_encode(char **restrict out, size_t *restrict n_out, const unsigned char *restrict in, size_t n_in, size_t n_prefix)
+{
+	if (n_in != BASE58CHECK21_PAYLOAD_SIZE)
+		return scratch_base58check_encode(out, n_out, in, n_in, n_prefix);
+	*out = palloc(n_prefix + BASE58CHECK21_MAX_SIZE + *n_out);
+	*n_out = n_prefix + base58check21_encode(*out + n_prefix, in);
+	return (ssize_t) *n_out;
+}
+
+static ssize_t
+fast_base58check_decode(unsigned char **restrict out, size_t *restrict n_out, const char *restrict in, size_t n_in, size_t n_prefix)
+{
+	uint8 payload[BASE58CHECK21_PAYLOAD_SIZE];
+	int ret = base58check21_decode(payload, in, n_in);
+	if (ret == 0)
+		return scratch_base58check_decode(out, n_out, in, n_in, n_prefix);
+	if (_unlikely(ret < 0))
+		return -1;
+	*out = palloc(*n_out = n_prefix + sizeof payload);
+	memcpy(*out + n_prefix, payload, sizeof payload);
+	return (ssize_t) *n_out;
+}
+
+
 PG_FUNCTION_INFO_V1(pg_base58check_encode);
 Datum
 pg_base58check_encode(PG_FUNCTION_ARGS)
@@ -19,7 +55,7 @@ pg_base58check_encode(PG_FUNCTION_ARGS)
 	size_t n_in = VARSIZE_ANY_EXHDR(arg), n_out = 0;
 	text *out = NULL;
 
-	if (_unlikely(base58check_encode((char **) &out, &n_out, in, n_in, VARHDRSZ) < 0))
+	if (_unlikely(fast_base58check_encode((char **) &out, &n_out, in, n_in, VARHDRSZ) < 0))
 		ereport(ERROR, errcode(ERRCODE_STRING_DATA_RIGHT_TRUNCATION),
 				errmsg("Base58Check encoding would exceed maximum allocation"));
 
@@ -37,7 +73,7 @@ pg_base58check_decode(PG_FUNCTION_ARGS)
 	size_t n_in = VARSIZE_ANY_EXHDR(arg), n_out = 0;
 	bytea *out = NULL;
 
-	if (_unlikely(base58check_decode((unsigned char **) &out, &n_out, in, n_in, VARHDRSZ) < 0))
+	if (_unlikely(fast_base58check_decode((unsigned char **) &out, &n_out, in, n_in, VARHDRSZ) < 0))
 		ereport(ERROR, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
 				errmsg("not a valid Base58Check encoding"),
 				errdetail_internal("%.*s", (int) n_in, in));
@@ -47,6 +83,23 @@ pg_base58check_decode(PG_FUNCTION_ARGS)
 }
 
 
+PG_FUNCTION_INFO_V1(pg_try_base58check_decode);
+Datum
+pg_try_base58check_decode(PG_FUNCTION_ARGS)
+{
+	const text *arg = PG_GETARG_TEXT_PP(0);
+	const char *in = VARDATA_ANY(arg);
+	size_t n_in = VARSIZE_ANY_EXHDR(arg), n_out = 0;
+	bytea *out = NULL;
+
+	if (fast_base58check_decode((unsigned char **) &out, &n_out, in, n_in, VARHDRSZ) < 0)
+		PG_RETURN_NULL();
+
+	SET_VARSIZE(out, n_out);
+	PG_RETURN_BYTEA_P(out);
+}
+
+
 PG_FUNCTION_INFO_V1(pg_base58check_output);
 Datum
 pg_base58check_output(PG_FUNCTION_ARGS)
@@ -56,7 +109,7 @@ pg_base58check_output(PG_FUNCTION_ARGS)
 	size_t n_in = VARSIZE_ANY_EXHDR(arg), n_out = 1/*null terminator*/;
 	char *out = NULL;
 
-	if (_unlikely(base58check_encode(&out, &n_out, in, n_in, 0) < 0))
+	if (_unlikely(fast_base58check_encode(&out, &n_out, in, n_in, 0) < 0))
 		ereport(ERROR, errcode(ERRCODE_STRING_DATA_RIGHT_TRUNCATION),
 				errmsg("Base58Check encoding would exceed maximum allocation"));
 
@@ -73,8 +126,8 @@ pg_base58check_input(PG_FUNCTION_ARGS)
 	size_t n_in = strlen(in), n_out = 0;
 	bytea *out = NULL;
 
-	if (_unlikely(base58check_decode((unsigned char **) &out, &n_out, in, n_in, VARHDRSZ) < 0))
-		ereport(ERROR, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+	if (_unlikely(fast_base58check_decode((unsigned char **) &out, &n_out, in, n_in, VARHDRSZ) < 0))
+		ereturn(fcinfo->context, (Datum) 0, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
 				errmsg("not a valid Base58Check encoding"),
 				errdetail_internal("%s", in));
 
@@ -83,6 +136,96 @@ pg_base58check_input(PG_FUNCTION_ARGS)
 }
 
 
+/*
+ * The binary wire format of base58check is a format version byte (currently 1) followed by the decoded payload.
+ */
+#define BASE58CHECK_BINARY_FORMAT 1
+
+PG_FUNCTION_INFO_V1(pg_base58check_receive);
+Datum
+pg_base58check_receive(PG_FUNCTION_ARGS)
+{
+	StringInfo buf = (StringInfo) PG_GETARG_POINTER(0);
+
+	int format = pq_getmsgbyte(buf);
+	if (_unlikely(format != BASE58CHECK_BINARY_FORMAT))
+		ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				errmsg("unsupported base58check binary format version %d", format));
+	int n_payload = buf->len - buf->cursor;
+	bytea *out = palloc(VARHDRSZ + n_payload);
+	pq_copymsgbytes(buf, VARDATA(out), n_payload);
+
+	SET_VARSIZE(out, VARHDRSZ + n_payload);
+	PG_RETURN_BYTEA_P(out);
+}
+
+PG_FUNCTION_INFO_V1(pg_base58check_send);
+Datum
+pg_base58check_send(PG_FUNCTION_ARGS)
+{
+	const bytea *arg = PG_GETARG_BYTEA_PP(0);
+
+	StringInfoData buf;
+	pq_begintypsend(&buf);
+	pq_sendbyte(&buf, BASE58CHECK_BINARY_FORMAT);
+	pq_sendbytes(&buf, VARDATA_ANY(arg), (int) VARSIZE_ANY_EXHDR(arg));
+	PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
+}
+
+
+PG_FUNCTION_INFO_V1(pg_base58check_hash);
+Datum
+pg_base58check_hash(PG_FUNCTION_ARGS)
+{
+	const bytea *arg = PG_GETARG_BYTEA_PP(0);
+
+	return hash_any((const unsigned char *) VARDATA_ANY(arg), (int) VARSIZE_ANY_EXHDR(arg));
+}
+
+PG_FUNCTION_INFO_V1(pg_base58check_hash_extended);
+Datum
+pg_base58check_hash_extended(PG_FUNCTION_ARGS)
+{
+	const bytea *arg = PG_GETARG_BYTEA_PP(0);
+
+	return hash_any_extended((const unsigned char *) VARDATA_ANY(arg), (int) VARSIZE_ANY_EXHDR(arg), PG_GETARG_INT64(1));
+}
+
+
+/*
+ * libbase58check allocates through base58check_malloc and base58check_free. Its calls are made with the scratch arena as the
+ * current memory context, so its working buffers and its result come from the arena's retained block rather than from a fresh
+ * allocation, and resetting the arena afterward releases everything at once.
+ */
+static MemoryContext scratch_context;
+
+static MemoryContext
+get_scratch_context(void)
+{
+	if (_unlikely(!scratch_context))
+		scratch_context = AllocSetContextCreate(TopMemoryContext, "libbase58check scratch", ALLOCSET_SMALL_SIZES);
+	return scratch_context;
+}
+
+#define DEFINE_SCRATCH_FUNCTION(name, out_type, in_type) \
+	ssize_t \
+	scratch_##name(out_type **restrict out, size_t *restrict n_out, const in_type *restrict in, size_t n_in, size_t n_prefix) \
+	{ \
+		size_t n_extra = *n_out; \
+		out_type *scratch_out = NULL; \
+		MemoryContext scratch = get_scratch_context(), oldcontext = MemoryContextSwitchTo(scratch); \
+		ssize_t ret = name(&scratch_out, n_out, in, n_in, n_prefix); \
+		MemoryContextSwitchTo(oldcontext); \
+		if (ret >= 0) \
+			*out = memcpy(palloc(*n_out + n_extra), scratch_out, *n_out); \
+		MemoryContextReset(scratch); \
+		return ret; \
+	}
+
+DEFINE_SCRATCH_FUNCTION(base58check_encode, char, unsigned char)
+DEFINE_SCRATCH_FUNCTION(base58check_decode, unsigned char, char)
+
+
 void base58check_free(void *ptr) {
 	pfree(ptr);
 }
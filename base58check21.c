@@ -0,0 +1,181 @@
+#include <postgres.h>
+
+#include "base58check21.h"
+#include "sha256.h"
+
+#define _likely(...) __builtin_expect(!!(__VA_ARGS__), 1)
+#define _unlikely(...) __builtin_expect(!!(__VA_ARGS__), 0)
+
+
+/*
+ * The payload and its 4-byte checksum (25 bytes, 200 bits) are held in seven 32-bit limbs, most significant first, and converted
+ * to and from base 58 five digits at a time, since 58^5 is the largest power of 58 that fits in a limb. Division by the constant
+ * 58^5 compiles to a multiplication, and the conversions have fixed trip counts, so the compiler can unroll them fully.
+ */
+#define CHECKSUM_SIZE 4
+#define ENCODED_BYTES (BASE58CHECK21_PAYLOAD_SIZE + CHECKSUM_SIZE)
+#define N_LIMBS 7
+#define LIMB_BYTES (N_LIMBS * sizeof(uint32))
+#define DIGITS_PER_LIMB 5
+#define BASE58_POW5 UINT32_C(656356768)
+
+static const char base58_alphabet[58] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+static const int8 base58_digits[128] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1,  0,  1,  2,  3,  4,  5,  6,  7,  8, -1, -1, -1, -1, -1, -1,
+	-1,  9, 10, 11, 12, 13, 14, 15, 16, -1, 17, 18, 19, 20, 21, -1,
+	22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, -1, -1, -1, -1, -1,
+	-1, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, -1, 44, 45, 46,
+	47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, -1, -1, -1, -1, -1,
+};
+
+static const uint32 base58_powers[DIGITS_PER_LIMB + 1] = { 1, 58, 58 * 58, 58 * 58 * 58, 58 * 58 * 58 * 58, BASE58_POW5 };
+
+static size_t __attribute__ ((__pure__))
+count_leading_zeros(const uint8 in[], size_t n_in)
+{
+	size_t n = 0;
+	while (n < n_in && in[n] == 0)
+		++n;
+	return n;
+}
+
+// encodes a payload and its checksum
+static size_t
+encode_digits(char out[BASE58CHECK21_MAX_SIZE], const uint8 in[BASE58CHECK21_PAYLOAD_SIZE], const uint8 checksum[CHECKSUM_SIZE])
+{
+	uint8 bytes[LIMB_BYTES] = { 0 }, *encoded = &bytes[LIMB_BYTES - ENCODED_BYTES];
+	memcpy(encoded, in, BASE58CHECK21_PAYLOAD_SIZE);
+	memcpy(&encoded[BASE58CHECK21_PAYLOAD_SIZE], checksum, CHECKSUM_SIZE);
+
+	uint32 limbs[N_LIMBS];
+	for (size_t i = 0; i < N_LIMBS; ++i)
+		limbs[i] = (uint32) bytes[i * 4] << 24 | (uint32) bytes[i * 4 + 1] << 16 | (uint32) bytes[i * 4 + 2] << 8 | bytes[i * 4 + 3];
+
+	uint8 digits[N_LIMBS * DIGITS_PER_LIMB];
+	for (size_t group = N_LIMBS; group-- > 0;) {
+		uint64 rem = 0;
+		for (size_t i = 0; i < N_LIMBS; ++i) {
+			uint64 cur = rem << 32 | limbs[i];
+			limbs[i] = (uint32) (cur / BASE58_POW5);
+			rem = cur % BASE58_POW5;
+		}
+		for (size_t j = DIGITS_PER_LIMB; j-- > 0;) {
+			digits[group * DIGITS_PER_LIMB + j] = (uint8) (rem % 58);
+			rem /= 58;
+		}
+	}
+
+	// each leading zero byte is encoded as a leading '1', and leading zero digits are dropped
+	size_t n_zeros = count_leading_zeros(encoded, ENCODED_BYTES), first = count_leading_zeros(digits, sizeof digits), n_out = 0;
+	while (n_out < n_zeros)
+		out[n_out++] = '1';
+	for (size_t i = first; i < sizeof digits; ++i)
+		out[n_out++] = base58_alphabet[digits[i]];
+	return n_out;
+}
+
+size_t
+base58check21_encode(char out[BASE58CHECK21_MAX_SIZE], const uint8 in[BASE58CHECK21_PAYLOAD_SIZE])
+{
+	uint8 digest[SHA256_DIGEST_SIZE];
+	sha256d(digest, in, BASE58CHECK21_PAYLOAD_SIZE);
+	return encode_digits(out, in, digest);
+}
+
+void
+base58check21_encode_batch(char out[][BASE58CHECK21_MAX_SIZE], size_t n_out[], const uint8 *const in[], size_t n)
+{
+	uint8 (*digests)[SHA256_DIGEST_SIZE] = palloc(Max(n, 1) * sizeof *digests);
+	sha256d_batch(digests, in, BASE58CHECK21_PAYLOAD_SIZE, n);
+	for (size_t i = 0; i < n; ++i)
+		n_out[i] = encode_digits(out[i], in[i], digests[i]);
+	pfree(digests);
+}
+
+// decodes a payload and its checksum without verifying the checksum; returns as base58check21_decode
+static int
+decode_digits(uint8 encoded[ENCODED_BYTES], const char in[], size_t n_in)
+{
+	if (_unlikely(n_in == 0 || n_in > BASE58CHECK21_MAX_SIZE))
+		return 0;
+
+	size_t n_ones = 0;
+	while (n_ones < n_in && in[n_ones] == '1')
+		++n_ones;
+
+	uint32 limbs[N_LIMBS] = { 0 };
+	for (size_t pos = 0, n_group = n_in % DIGITS_PER_LIMB ?: DIGITS_PER_LIMB; pos < n_in; pos += n_group, n_group = DIGITS_PER_LIMB) {
+		uint32 acc = 0;
+		for (size_t j = 0; j < n_group; ++j) {
+			uint8 c = (uint8) in[pos + j];
+			int8 digit = c < sizeof base58_digits ? base58_digits[c] : -1;
+			if (_unlikely(digit < 0))
+				return -1;
+			acc = acc * 58 + (uint32) digit;
+		}
+		uint64 carry = acc;
+		for (size_t i = N_LIMBS; i-- > 0;) {
+			uint64 cur = (uint64) limbs[i] * base58_powers[n_group] + carry;
+			limbs[i] = (uint32) cur;
+			carry = cur >> 32;
+		}
+		if (carry)
+			return 0;
+	}
+
+	uint8 bytes[LIMB_BYTES];
+	for (size_t i = 0; i < N_LIMBS; ++i) {
+		bytes[i * 4] = (uint8) (limbs[i] >> 24), bytes[i * 4 + 1] = (uint8) (limbs[i] >> 16);
+		bytes[i * 4 + 2] = (uint8) (limbs[i] >> 8), bytes[i * 4 + 3] = (uint8) limbs[i];
+	}
+	// the decoded size is the number of leading '1's plus the number of significant bytes
+	if (count_leading_zeros(bytes, LIMB_BYTES - ENCODED_BYTES) < LIMB_BYTES - ENCODED_BYTES ||
+			count_leading_zeros(&bytes[LIMB_BYTES - ENCODED_BYTES], ENCODED_BYTES) != n_ones)
+		return 0;
+	memcpy(encoded, &bytes[LIMB_BYTES - ENCODED_BYTES], ENCODED_BYTES);
+	return 1;
+}
+
+int
+base58check21_decode(uint8 out[BASE58CHECK21_PAYLOAD_SIZE], const char in[], size_t n_in)
+{
+	uint8 encoded[ENCODED_BYTES];
+	int ret = decode_digits(encoded, in, n_in);
+	if (ret <= 0)
+		return ret;
+
+	uint8 digest[SHA256_DIGEST_SIZE];
+	sha256d(digest, encoded, BASE58CHECK21_PAYLOAD_SIZE);
+	if (_unlikely(memcmp(digest, &encoded[BASE58CHECK21_PAYLOAD_SIZE], CHECKSUM_SIZE) != 0))
+		return -1;
+	memcpy(out, encoded, BASE58CHECK21_PAYLOAD_SIZE);
+	return 1;
+}
+
+void
+base58check21_decode_batch(uint8 out[][BASE58CHECK21_PAYLOAD_SIZE], int ret[], const char *const in[], const size_t n_in[], size_t n)
+{
+	uint8 (*encoded)[ENCODED_BYTES] = palloc(Max(n, 1) * sizeof *encoded);
+	const uint8 **payloads = palloc(Max(n, 1) * sizeof *payloads);
+	size_t *idx = palloc(Max(n, 1) * sizeof *idx), n_decoded = 0;
+	for (size_t i = 0; i < n; ++i)
+		if ((ret[i] = decode_digits(encoded[n_decoded], in[i], n_in[i])) > 0)
+			payloads[n_decoded] = encoded[n_decoded], idx[n_decoded++] = i;
+
+	uint8 (*digests)[SHA256_DIGEST_SIZE] = palloc(Max(n_decoded, 1) * sizeof *digests);
+	sha256d_batch(digests, payloads, BASE58CHECK21_PAYLOAD_SIZE, n_decoded);
+	for (size_t j = 0; j < n_decoded; ++j)
+		if (_unlikely(memcmp(digests[j], &encoded[j][BASE58CHECK21_PAYLOAD_SIZE], CHECKSUM_SIZE) != 0))
+			ret[idx[j]] = -1;
+		else
+			memcpy(out[idx[j]], encoded[j], BASE58CHECK21_PAYLOAD_SIZE);
+
+	pfree(digests);
+	pfree(idx);
+	pfree(payloads);
+	pfree(encoded);
+}
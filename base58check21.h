@@ -0,0 +1,26 @@
+#include <postgres.h>
+
+#pragma GCC visibility push(hidden)
+
+/*
+ * A specialized Base58Check codec for 21-byte payloads (a version byte followed by a 20-byte hash), which is the payload size of
+ * nearly all legacy Bitcoin addresses. Other payload sizes must use the general codec of libbase58check.
+ */
+#define BASE58CHECK21_PAYLOAD_SIZE 21
+#define BASE58CHECK21_MAX_SIZE 35
+
+size_t base58check21_encode(char out[BASE58CHECK21_MAX_SIZE], const uint8 in[BASE58CHECK21_PAYLOAD_SIZE])
+	__attribute__ ((__access__ (write_only, 1), __access__ (read_only, 2), __nonnull__, __nothrow__));
+
+// returns 1 on success, 0 if the encoded payload is not 21 bytes in size, or -1 if the encoding is invalid
+int base58check21_decode(uint8 out[BASE58CHECK21_PAYLOAD_SIZE], const char in[], size_t n_in)
+	__attribute__ ((__access__ (write_only, 1), __access__ (read_only, 2, 3), __nonnull__ (1), __nothrow__, __warn_unused_result__));
+
+// batch variants of the above, which compute the checksums of all n payloads together
+void base58check21_encode_batch(char out[][BASE58CHECK21_MAX_SIZE], size_t n_out[], const uint8 *const in[], size_t n)
+	__attribute__ ((__access__ (write_only, 1, 4), __access__ (write_only, 2, 4), __access__ (read_only, 3, 4)));
+
+void base58check21_decode_batch(uint8 out[][BASE58CHECK21_PAYLOAD_SIZE], int ret[], const char *const in[], const size_t n_in[], size_t n)
+	__attribute__ ((__access__ (write_only, 1, 5), __access__ (write_only, 2, 5), __access__ (read_only, 3, 5), __access__ (read_only, 4, 5)));
+
+#pragma GCC visibility pop
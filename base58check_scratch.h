@@ -0,0 +1,18 @@
+#include <postgres.h>
+
+#pragma GCC visibility push(hidden)
+
+/*
+ * These call the functions of libbase58check having the same names without the prefix and have the same signatures. The library's
+ * allocations are carved from a scratch arena that is reset after each call and reused by the next, and only the result (including
+ * the requested prefix and trailing room) is copied into the current memory context.
+ */
+ssize_t scratch_base58check_encode(char **restrict out, size_t *restrict n_out,
+		const unsigned char *restrict in, size_t n_in, size_t n_prefix)
+	__attribute__ ((__access__ (write_only, 1), __access__ (read_write, 2), __access__ (read_only, 3, 4), __nonnull__ (1, 2)));
+
+ssize_t scratch_base58check_decode(unsigned char **restrict out, size_t *restrict n_out,
+		const char *restrict in, size_t n_in, size_t n_prefix)
+	__attribute__ ((__access__ (write_only, 1), __access__ (read_write, 2), __access__ (read_only, 3, 4), __nonnull__ (1, 2)));
+
+#pragma GCC visibility pop
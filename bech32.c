@@ -8,6 +8,7 @@
 #include <utils/varbit.h>
 
 #include "bech32.h"
+#include "soft_error.h"
 
 #define _likely(...) __builtin_expect(!!(__VA_ARGS__), 1)
 #define _unlikely(...) __builtin_expect(!!(__VA_ARGS__), 0)
@@ -163,65 +164,65 @@ bech32_check_encode_error(enum bech32_error error, const struct bech32_params *p
 	Datum pg_##bech32##m_encode(PG_FUNCTION_ARGS) { return bech32##_encode(fcinfo, BECH32##M_CONST); }
 
 
-void
-bech32_check_decode_error(ssize_t ret, const char in[], size_t n_in)
+bool
+bech32_check_decode_error(ssize_t ret, const char in[], size_t n_in, struct Node *escontext)
 {
-	if (_likely(ret >= 0)) return;
+	if (_likely(ret >= 0)) return true;
 	switch ((enum bech32_error) ret) {
 		case BECH32_TOO_SHORT:
-			ereport(ERROR, errcode(ERRCODE_STRING_DATA_LENGTH_MISMATCH),
+			ereturn(escontext, false, errcode(ERRCODE_STRING_DATA_LENGTH_MISMATCH),
 					errmsg("Bech32 encoding is too short"),
 					errdetail_internal("%.*s", (int) n_in, in));
 		case BECH32_TOO_LONG:
-			ereport(ERROR, errcode(ERRCODE_STRING_DATA_LENGTH_MISMATCH),
+			ereturn(escontext, false, errcode(ERRCODE_STRING_DATA_LENGTH_MISMATCH),
 					errmsg("Bech32 encoding is too long"),
 					errdetail_internal("%.*s", (int) n_in, in));
 		case BECH32_NO_SEPARATOR:
-			ereport(ERROR, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+			ereturn(escontext, false, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
 					errmsg("Bech32 encoding contains no separator"),
 					errdetail_internal("%.*s", (int) n_in, in));
 		case BECH32_MIXED_CASE:
-			ereport(ERROR, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+			ereturn(escontext, false, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
 					errmsg("Bech32 encoding uses mixed case"),
 					errdetail_internal("%.*s", (int) n_in, in));
 		case BECH32_ILLEGAL_CHAR:
-			ereport(ERROR, errcode(ERRCODE_CHARACTER_NOT_IN_REPERTOIRE),
+			ereturn(escontext, false, errcode(ERRCODE_CHARACTER_NOT_IN_REPERTOIRE),
 					errmsg("Bech32 encoding contains an illegal character"),
 					errdetail_internal("%.*s", (int) n_in, in));
 		case BECH32_PADDING_ERROR:
-			ereport(ERROR, errcode(ERRCODE_STRING_DATA_LENGTH_MISMATCH),
+			ereturn(escontext, false, errcode(ERRCODE_STRING_DATA_LENGTH_MISMATCH),
 					errmsg("Bech32 encoding has a padding error"),
 					errdetail_internal("%.*s", (int) n_in, in));
 		case BECH32_CHECKSUM_FAILURE:
-			ereport(ERROR, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+			ereturn(escontext, false, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
 					errmsg("Bech32 checksum verification failed"),
 					errdetail_internal("%.*s", (int) n_in, in));
 		case BECH32_HRP_TOO_SHORT:
-			ereport(ERROR, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+			ereturn(escontext, false, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
 					errmsg("Bech32 human-readable prefix is empty"),
 					errdetail_internal("%.*s", (int) n_in, in));
 		case BECH32_HRP_TOO_LONG:
-			ereport(ERROR, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+			ereturn(escontext, false, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
 					errmsg("Bech32 human-readable prefix is too long"),
 					errdetail_internal("%.*s", (int) n_in, in));
 		case BECH32_HRP_ILLEGAL_CHAR:
-			ereport(ERROR, errcode(ERRCODE_CHARACTER_NOT_IN_REPERTOIRE),
+			ereturn(escontext, false, errcode(ERRCODE_CHARACTER_NOT_IN_REPERTOIRE),
 					errmsg("Bech32 human-readable prefix contains an illegal character"),
 					errdetail_internal("%.*s", (int) n_in, in));
 		case SEGWIT_VERSION_ILLEGAL:
-			ereport(ERROR, errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+			ereturn(escontext, false, errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
 					errmsg("witness version is illegal"),
 					errdetail_internal("%.*s", (int) n_in, in));
 		case SEGWIT_PROGRAM_TOO_SHORT:
-			ereport(ERROR, errcode(ERRCODE_STRING_DATA_LENGTH_MISMATCH),
+			ereturn(escontext, false, errcode(ERRCODE_STRING_DATA_LENGTH_MISMATCH),
 					errmsg("witness program is too short"),
 					errdetail_internal("%.*s", (int) n_in, in));
 		case SEGWIT_PROGRAM_TOO_LONG:
-			ereport(ERROR, errcode(ERRCODE_STRING_DATA_LENGTH_MISMATCH),
+			ereturn(escontext, false, errcode(ERRCODE_STRING_DATA_LENGTH_MISMATCH),
 					errmsg("witness program is too long"),
 					errdetail_internal("%.*s", (int) n_in, in));
 		case SEGWIT_PROGRAM_ILLEGAL_SIZE:
-			ereport(ERROR, errcode(ERRCODE_STRING_DATA_LENGTH_MISMATCH),
+			ereturn(escontext, false, errcode(ERRCODE_STRING_DATA_LENGTH_MISMATCH),
 					errmsg("witness program is of an illegal size"),
 					errdetail_internal("%.*s", (int) n_in, in));
 		case BECH32_BUFFER_INADEQUATE:
@@ -234,24 +235,27 @@ bech32_check_decode_error(ssize_t ret, const char in[], size_t n_in)
 
 #define DEFINE_DECODE_FUNCTIONS(bech32, BECH32) \
 	static Datum \
-	bech32##_do_decode(const char in[], size_t n_in, bech32##_constant_t constant) \
+	bech32##_do_decode(const char in[], size_t n_in, bech32##_constant_t constant, struct Node *escontext) \
 	{ \
 		struct bech32##_decoder_state state; \
 	\
-		bech32_check_decode_error(bech32##_decode_begin(&state, in, n_in), in, n_in); \
+		if (!bech32_check_decode_error(bech32##_decode_begin(&state, in, n_in), in, n_in, escontext)) \
+			return (Datum) 0; \
 	\
 		size_t nbits_out = bech32##_decode_bits_remaining(&state), n_out = VARBITTOTALLEN(nbits_out); \
 		VarBit *out = palloc(n_out); \
 		SET_VARSIZE(out, n_out); \
 		VARBITLEN(out) = (int) nbits_out; \
 	\
-		bech32_check_decode_error(bech32##_decode_data(&state, VARBITS(out), nbits_out), in, n_in); \
+		if (!bech32_check_decode_error(bech32##_decode_data(&state, VARBITS(out), nbits_out), in, n_in, escontext)) \
+			return (Datum) 0; \
 	\
 		size_t nbits_extra = nbits_out % BITS_PER_BYTE; \
 		if (nbits_extra) \
 			VARBITEND(out)[-1] <<= BITS_PER_BYTE - nbits_extra; \
 	\
-		bech32_check_decode_error(bech32##_decode_finish(&state, constant), in, n_in); \
+		if (!bech32_check_decode_error(bech32##_decode_finish(&state, constant), in, n_in, escontext)) \
+			return (Datum) 0; \
 	\
 		PG_RETURN_VARBIT_P(out); \
 	} \
@@ -262,7 +266,20 @@ bech32_check_decode_error(ssize_t ret, const char in[], size_t n_in)
 		const text *in = PG_GETARG_TEXT_PP(0); \
 		size_t n_in = VARSIZE_ANY_EXHDR(in); \
 	\
-		return bech32##_do_decode(VARDATA_ANY(in), n_in, constant); \
+		return bech32##_do_decode(VARDATA_ANY(in), n_in, constant, NULL); \
+	} \
+	\
+	static Datum \
+	try_##bech32##_decode(PG_FUNCTION_ARGS, bech32##_constant_t constant) \
+	{ \
+		const text *in = PG_GETARG_TEXT_PP(0); \
+		size_t n_in = VARSIZE_ANY_EXHDR(in); \
+	\
+		ErrorSaveContext escontext = { T_ErrorSaveContext }; \
+		Datum out = bech32##_do_decode(VARDATA_ANY(in), n_in, constant, (struct Node *) &escontext); \
+		if (SOFT_ERROR_OCCURRED(&escontext)) \
+			PG_RETURN_NULL(); \
+		return out; \
 	} \
 	\
 	PG_FUNCTION_INFO_V1(pg_##bech32##_decode); \
@@ -271,6 +288,12 @@ bech32_check_decode_error(ssize_t ret, const char in[], size_t n_in)
 	PG_FUNCTION_INFO_V1(pg_##bech32##m_decode); \
 	Datum pg_##bech32##m_decode(PG_FUNCTION_ARGS) { return bech32##_decode(fcinfo, BECH32##M_CONST); } \
 	\
+	PG_FUNCTION_INFO_V1(pg_try_##bech32##_decode); \
+	Datum pg_try_##bech32##_decode(PG_FUNCTION_ARGS) { return try_##bech32##_decode(fcinfo, 1); } \
+	\
+	PG_FUNCTION_INFO_V1(pg_try_##bech32##m_decode); \
+	Datum pg_try_##bech32##m_decode(PG_FUNCTION_ARGS) { return try_##bech32##_decode(fcinfo, BECH32##M_CONST); } \
+	\
 	\
 	PG_FUNCTION_INFO_V1(pg_##bech32##_hrp); \
 	Datum \
@@ -281,7 +304,7 @@ bech32_check_decode_error(ssize_t ret, const char in[], size_t n_in)
 	\
 		struct bech32##_decoder_state state; \
 		ssize_t n_hrp = bech32##_decode_begin(&state, VARDATA_ANY(in), n_in); \
-		bech32_check_decode_error(n_hrp, VARDATA_ANY(in), n_in); \
+		bech32_check_decode_error(n_hrp, VARDATA_ANY(in), n_in, NULL); \
 	\
 		PG_RETURN_TEXT_P(cstring_to_text_with_len(VARDATA_ANY(in), (int) n_hrp)); \
 	}
@@ -22,7 +22,7 @@ extern const struct bech32_params bech32_params, blech32_params;
 void bech32_check_encode_error(enum bech32_error error, const struct bech32_params *params)
 	__attribute__ ((__nothrow__));
 
-void bech32_check_decode_error(ssize_t ret, const char in[], size_t n_in)
-	__attribute__ ((__access__ (read_only, 2), __nonnull__, __nothrow__));
+bool bech32_check_decode_error(ssize_t ret, const char in[], size_t n_in, struct Node *escontext)
+	__attribute__ ((__access__ (read_only, 2), __nonnull__ (2), __nothrow__));
 
 #pragma GCC visibility pop
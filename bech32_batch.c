@@ -0,0 +1,297 @@
+#include <postgres.h>
+
+#include "bech32.h"
+#include "bech32_batch.h"
+
+#define _likely(...) __builtin_expect(!!(__VA_ARGS__), 1)
+#define _unlikely(...) __builtin_expect(!!(__VA_ARGS__), 0)
+
+
+static const char bech32_charset[32] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+
+// the value of each Bech32 data character (in either case), filled in by bech32_batch_init
+static uint8 bech32_charset_values[256];
+
+/*
+ * Bech32 uses a 30-bit BCH code and Blech32 uses a 60-bit one. In each step of the checksum computation, the state is shifted
+ * left by one symbol, and the generator is XORed in for each bit of the symbol that was shifted out.
+ */
+static const uint32 bech32_generator[5] = { 0x3B6A57B2, 0x26508E6D, 0x1EA119FA, 0x3D4233DD, 0x2A1462B3 };
+#define BECH32_POLYMOD_SHIFT 25
+#define BECH32_POLYMOD_MASK UINT32_C(0x1FFFFFF)
+
+static const uint64 blech32_generator[5] = { 0x7D52FBA40BD886, 0x5E8DBF1A03950C, 0x1C3A3C74072A18, 0x385D72FA0E5139, 0x7093E5A608865B };
+#define BLECH32_POLYMOD_SHIFT 55
+#define BLECH32_POLYMOD_MASK UINT64_C(0x7FFFFFFFFFFFFF)
+
+/*
+ * A polymod kernel computes the checksum states of n inputs, each given as an array of 5-bit symbols. Each group of LANES inputs
+ * is processed in parallel in the lanes of a GCC generic vector, which the compiler maps onto the registers of the target
+ * instruction set. Inputs of unequal lengths are handled by freezing the state of a lane once its input is exhausted.
+ */
+#define DEFINE_POLYMOD_KERNEL(name, attributes, uintN, LANES, generator, SHIFT, MASK) \
+	static void attributes \
+	name(uintN out[], const uint8 *const symbols[], const size_t n_symbols[], size_t n) \
+	{ \
+		typedef uintN vec __attribute__ ((__vector_size__ (LANES * sizeof(uintN)))); \
+	\
+		for (size_t base = 0; base < n; base += LANES) { \
+			size_t n_lanes = Min(LANES, n - base), max_symbols = 0; \
+			for (size_t lane = 0; lane < n_lanes; ++lane) \
+				max_symbols = Max(max_symbols, n_symbols[base + lane]); \
+	\
+			vec c = (vec) { 0 } + 1; \
+			for (size_t j = 0; j < max_symbols; ++j) { \
+				vec v = { 0 }, active = { 0 }; \
+				for (size_t lane = 0; lane < n_lanes; ++lane) \
+					if (_likely(j < n_symbols[base + lane])) \
+						v[lane] = symbols[base + lane][j], active[lane] = (uintN) -1; \
+				vec c0 = c >> SHIFT, next = (c & MASK) << 5 ^ v; \
+				for (unsigned i = 0; i < 5; ++i) \
+					next ^= generator[i] & -(c0 >> i & 1); \
+				c = next & active | c & ~active; \
+			} \
+	\
+			for (size_t lane = 0; lane < n_lanes; ++lane) \
+				out[base + lane] = c[lane]; \
+		} \
+	}
+
+#define DEFINE_POLYMOD_KERNELS(suffix, attributes, LANES32, LANES64) \
+	DEFINE_POLYMOD_KERNEL(bech32_polymod_##suffix, attributes, uint32, LANES32, bech32_generator, BECH32_POLYMOD_SHIFT, BECH32_POLYMOD_MASK) \
+	DEFINE_POLYMOD_KERNEL(blech32_polymod_##suffix, attributes, uint64, LANES64, blech32_generator, BLECH32_POLYMOD_SHIFT, BLECH32_POLYMOD_MASK)
+
+#if defined(__x86_64__) || defined(__i386__)
+DEFINE_POLYMOD_KERNELS(avx2, __attribute__ ((__target__ ("avx2"))), 8, 4)
+DEFINE_POLYMOD_KERNELS(sse4, __attribute__ ((__target__ ("sse4.1"))), 4, 2)
+#endif
+DEFINE_POLYMOD_KERNELS(generic, , 2, 1)
+
+static void (*bech32_polymod)(uint32 [], const uint8 *const [], const size_t [], size_t) = &bech32_polymod_generic;
+static void (*blech32_polymod)(uint64 [], const uint8 *const [], const size_t [], size_t) = &blech32_polymod_generic;
+
+void
+bech32_batch_init(void)
+{
+	for (size_t i = 0; i < sizeof bech32_charset; ++i) {
+		char c = bech32_charset[i];
+		bech32_charset_values[(uint8) c] = (uint8) i;
+		if (c >= 'a' && c <= 'z')
+			bech32_charset_values[(uint8) (c - 'a' + 'A')] = (uint8) i;
+	}
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		bech32_polymod = &bech32_polymod_avx2, blech32_polymod = &blech32_polymod_avx2;
+	else if (__builtin_cpu_supports("sse4.1"))
+		bech32_polymod = &bech32_polymod_sse4, blech32_polymod = &blech32_polymod_sse4;
+#endif
+}
+
+
+/*
+ * Regroups bytes into 5-bit symbols, padding the final symbol with zero bits. Each 5 input bytes yield exactly 8 symbols, so the
+ * bulk of the input is converted 40 bits at a time.
+ */
+size_t
+bech32_regroup_8to5(uint8 out[], const uint8 in[], size_t n_in)
+{
+	size_t n_out = 0;
+	for (; n_in >= 5; in += 5, n_in -= 5, n_out += 8) {
+		uint64 acc = (uint64) in[0] << 32 | (uint64) in[1] << 24 | (uint64) in[2] << 16 | (uint64) in[3] << 8 | in[4];
+		for (size_t i = 0; i < 8; ++i)
+			out[n_out + i] = (uint8) (acc >> 35 - 5 * i & 0x1F);
+	}
+	uint32 acc = 0;
+	unsigned nbits = 0;
+	for (size_t i = 0; i < n_in; ++i)
+		for (acc = acc << 8 | in[i], nbits += 8; nbits >= 5;)
+			out[n_out++] = (uint8) (acc >> (nbits -= 5) & 0x1F);
+	if (nbits)
+		out[n_out++] = (uint8) (acc << 5 - nbits & 0x1F);
+	return n_out;
+}
+
+/*
+ * Regroups 5-bit symbols into bytes. Each 8 input symbols yield exactly 5 bytes, so the bulk of the input is converted 40 bits at a
+ * time. The final symbols may leave up to 4 bits of padding, which must be zero.
+ */
+ssize_t
+bech32_regroup_5to8(uint8 out[], const uint8 in[], size_t n_in)
+{
+	size_t n_out = 0;
+	for (; n_in >= 8; in += 8, n_in -= 8, n_out += 5) {
+		uint64 acc = 0;
+		for (size_t i = 0; i < 8; ++i)
+			acc = acc << 5 | in[i];
+		for (size_t i = 0; i < 5; ++i)
+			out[n_out + i] = (uint8) (acc >> 32 - 8 * i);
+	}
+	uint64 acc = 0;
+	unsigned nbits = 0;
+	for (size_t i = 0; i < n_in; ++i)
+		for (acc = acc << 5 | in[i], nbits += 5; nbits >= 8;)
+			out[n_out++] = (uint8) (acc >> (nbits -= 8));
+	if (nbits >= 5 || acc & ((UINT64_C(1) << nbits) - 1))
+		return -1;
+	return (ssize_t) n_out;
+}
+
+static size_t __attribute__ ((__const__))
+checksum_size(bool blech)
+{
+	return blech ? BLECH32_CHECKSUM_SIZE : BECH32_CHECKSUM_SIZE;
+}
+
+static size_t __attribute__ ((__const__))
+data_size(size_t n_program)
+{
+	return 1/*version*/ + (n_program * BITS_PER_BYTE + 4) / 5;
+}
+
+size_t
+segwit_batch_encoded_size(const struct segwit_batch_entry *entry)
+{
+	return entry->n_hrp + 1/*separator*/ + data_size(entry->n_program) + checksum_size(entry->blech);
+}
+
+void
+segwit_batch_encode(struct segwit_batch_entry entries[], size_t n_entries)
+{
+	if (n_entries == 0)
+		return;
+
+	/*
+	 * Each checksum input is the expanded HRP (the high bits of each character, a zero, and the low bits of each character),
+	 * followed by the data symbols, followed by as many zero symbols as there are checksum symbols.
+	 */
+	size_t n_total = 0;
+	for (size_t i = 0; i < n_entries; ++i)
+		n_total += entries[i].n_hrp * 2 + 1 + data_size(entries[i].n_program) + checksum_size(entries[i].blech);
+	uint8 *buffer = palloc(n_total);
+	const uint8 **symbols = palloc(n_entries * sizeof *symbols);
+	size_t *n_symbols = palloc(n_entries * sizeof *n_symbols), *order = palloc(n_entries * sizeof *order);
+
+	// Bech32 entries are placed at the front and Blech32 entries at the back, so that each kernel sees a contiguous run.
+	size_t n_bech32 = 0, n_blech32 = 0;
+	uint8 *p = buffer;
+	for (size_t i = 0; i < n_entries; ++i) {
+		const struct segwit_batch_entry *entry = &entries[i];
+		size_t idx = entry->blech ? n_entries - ++n_blech32 : n_bech32++;
+		order[idx] = i;
+		symbols[idx] = p;
+		for (size_t j = 0; j < entry->n_hrp; ++j)
+			*p++ = (uint8) entry->hrp[j] >> 5;
+		*p++ = 0;
+		for (size_t j = 0; j < entry->n_hrp; ++j)
+			*p++ = (uint8) entry->hrp[j] & 0x1F;
+		*p++ = entry->version;
+		p += bech32_regroup_8to5(p, entry->program, entry->n_program);
+		memset(p, 0, checksum_size(entry->blech));
+		p += checksum_size(entry->blech);
+		n_symbols[idx] = (size_t) (p - symbols[idx]);
+	}
+
+	uint32 *bech32_checksums = palloc(Max(n_bech32, 1) * sizeof *bech32_checksums);
+	uint64 *blech32_checksums = palloc(Max(n_blech32, 1) * sizeof *blech32_checksums);
+	(*bech32_polymod)(bech32_checksums, symbols, n_symbols, n_bech32);
+	(*blech32_polymod)(blech32_checksums, symbols + n_bech32, n_symbols + n_bech32, n_blech32);
+
+	for (size_t idx = 0; idx < n_entries; ++idx) {
+		const struct segwit_batch_entry *entry = &entries[order[idx]];
+		size_t n_checksum = checksum_size(entry->blech);
+		uint64 checksum = entry->blech ?
+				blech32_checksums[idx - n_bech32] ^ (entry->version ? BLECH32M_CONST : 1) :
+				bech32_checksums[idx] ^ (entry->version ? BECH32M_CONST : 1);
+
+		char *out = entry->out;
+		memcpy(out, entry->hrp, entry->n_hrp);
+		out += entry->n_hrp;
+		*out++ = '1';
+		const uint8 *data = symbols[idx] + entry->n_hrp * 2 + 1;
+		for (size_t j = 0, n_data = data_size(entry->n_program); j < n_data; ++j)
+			*out++ = bech32_charset[data[j]];
+		for (size_t j = 0; j < n_checksum; ++j)
+			*out++ = bech32_charset[checksum >> 5 * (n_checksum - 1 - j) & 0x1F];
+	}
+
+	pfree(blech32_checksums);
+	pfree(bech32_checksums);
+	pfree(order);
+	pfree(n_symbols);
+	pfree(symbols);
+	pfree(buffer);
+}
+
+size_t
+segwit_batch_program_size(const struct segwit_batch_decode_entry *entry)
+{
+	return (entry->n_in - entry->n_hrp - 1/*separator*/ - 1/*version*/ - checksum_size(entry->blech)) * 5 / BITS_PER_BYTE;
+}
+
+void
+segwit_batch_decode(struct segwit_batch_decode_entry entries[], size_t n_entries)
+{
+	if (n_entries == 0)
+		return;
+
+	// Each checksum input is the expanded lowercase HRP followed by the data symbols, including those of the checksum.
+	size_t n_total = 0;
+	for (size_t i = 0; i < n_entries; ++i)
+		n_total += entries[i].n_hrp * 2 + 1 + entries[i].n_in - entries[i].n_hrp - 1/*separator*/;
+	uint8 *buffer = palloc(n_total);
+	const uint8 **symbols = palloc(n_entries * sizeof *symbols);
+	size_t *n_symbols = palloc(n_entries * sizeof *n_symbols), *order = palloc(n_entries * sizeof *order);
+
+	size_t n_bech32 = 0, n_blech32 = 0;
+	uint8 *p = buffer;
+	for (size_t i = 0; i < n_entries; ++i) {
+		const struct segwit_batch_decode_entry *entry = &entries[i];
+		size_t idx = entry->blech ? n_entries - ++n_blech32 : n_bech32++;
+		order[idx] = i;
+		symbols[idx] = p;
+		for (size_t j = 0; j < entry->n_hrp; ++j)
+			*p++ = (uint8) (entry->in[j] | (entry->in[j] >= 'A' && entry->in[j] <= 'Z' ? 0x20 : 0)) >> 5;
+		*p++ = 0;
+		for (size_t j = 0; j < entry->n_hrp; ++j)
+			*p++ = (uint8) entry->in[j] & 0x1F;
+		for (size_t j = entry->n_hrp + 1/*separator*/; j < entry->n_in; ++j)
+			*p++ = bech32_charset_values[(uint8) entry->in[j]];
+		n_symbols[idx] = (size_t) (p - symbols[idx]);
+	}
+
+	uint32 *bech32_residues = palloc(Max(n_bech32, 1) * sizeof *bech32_residues);
+	uint64 *blech32_residues = palloc(Max(n_blech32, 1) * sizeof *blech32_residues);
+	(*bech32_polymod)(bech32_residues, symbols, n_symbols, n_bech32);
+	(*blech32_polymod)(blech32_residues, symbols + n_bech32, n_symbols + n_bech32, n_blech32);
+
+	for (size_t idx = 0; idx < n_entries; ++idx) {
+		struct segwit_batch_decode_entry *entry = &entries[order[idx]];
+		const struct bech32_params *params = entry->blech ? &blech32_params : &bech32_params;
+		const uint8 *data = symbols[idx] + entry->n_hrp * 2 + 1;
+		size_t n_data = n_symbols[idx] - (entry->n_hrp * 2 + 1), n_checksum = checksum_size(entry->blech);
+		entry->valid = false;
+		if (_unlikely(n_data < 1/*version*/ + n_checksum))
+			continue;
+
+		uint8 version = data[0];
+		uint64 residue = entry->blech ? blech32_residues[idx - n_bech32] : bech32_residues[idx];
+		if (_unlikely(version > WITNESS_MAX_VERSION ||
+				residue != (entry->blech ? (version ? BLECH32M_CONST : 1) : (version ? BECH32M_CONST : 1))))
+			continue;
+		ssize_t n_program = bech32_regroup_5to8(entry->program, data + 1, n_data - 1 - n_checksum);
+		if (_unlikely(n_program < 0 || (size_t) n_program < params->program_min_size ||
+				(size_t) n_program > params->program_max_size ||
+				version == 0 && (size_t) n_program != params->program_pkh_size && (size_t) n_program != params->program_sh_size))
+			continue;
+		entry->version = version;
+		entry->valid = true;
+	}
+
+	pfree(blech32_residues);
+	pfree(bech32_residues);
+	pfree(order);
+	pfree(n_symbols);
+	pfree(symbols);
+	pfree(buffer);
+}
@@ -0,0 +1,55 @@
+#include <postgres.h>
+
+#pragma GCC visibility push(hidden)
+
+/*
+ * Batch encoding and decoding of native SegWit addresses. The Bech32/Blech32 checksums of many addresses are computed together,
+ * one address per SIMD lane, using the widest kernel that the CPU supports, as selected by bech32_batch_init at module load.
+ */
+struct segwit_batch_entry {
+	const char *hrp;
+	size_t n_hrp;
+	const uint8 *program;
+	size_t n_program;
+	uint8 version;
+	bool blech;
+	char *out; // receives segwit_batch_encoded_size(entry) characters (not null-terminated)
+};
+
+void bech32_batch_init(void);
+
+size_t segwit_batch_encoded_size(const struct segwit_batch_entry *entry)
+	__attribute__ ((__nonnull__, __pure__));
+
+void segwit_batch_encode(struct segwit_batch_entry entries[], size_t n_entries)
+	__attribute__ ((__access__ (read_write, 1, 2)));
+
+/*
+ * An address to be decoded. The caller has established that it consists of an HRP of n_hrp characters, a separator, and only
+ * Bech32 data characters, without mixed case, and chooses the encoding to verify. Decoding succeeds only if the checksum, the
+ * witness version, the padding, and the program size are all valid; the caller may then retry any failed entry with a decoder
+ * that reports the problem.
+ */
+struct segwit_batch_decode_entry {
+	const char *in;
+	size_t n_in, n_hrp;
+	bool blech;
+	uint8 *program; // receives the program, which has segwit_batch_program_size(entry) bytes
+	uint8 version; // set on success
+	bool valid; // set to whether decoding succeeded
+};
+
+size_t segwit_batch_program_size(const struct segwit_batch_decode_entry *entry)
+	__attribute__ ((__nonnull__, __pure__));
+
+void segwit_batch_decode(struct segwit_batch_decode_entry entries[], size_t n_entries)
+	__attribute__ ((__access__ (read_write, 1, 2)));
+
+size_t bech32_regroup_8to5(uint8 out[], const uint8 in[], size_t n_in)
+	__attribute__ ((__access__ (write_only, 1), __access__ (read_only, 2, 3), __nothrow__));
+
+// returns the number of bytes, or -1 if the padding is longer than 4 bits or is not all zero bits
+ssize_t bech32_regroup_5to8(uint8 out[], const uint8 in[], size_t n_in)
+	__attribute__ ((__access__ (write_only, 1), __access__ (read_only, 2, 3), __nothrow__));
+
+#pragma GCC visibility pop
@@ -0,0 +1,374 @@
+/*
+ * Standalone microbenchmarks of the extension's packing and codec paths on a deterministic synthetic corpus whose mix of networks
+ * and address types resembles that of the Bitcoin and Liquid chains. Each benchmark processes the corpus in chunks and reports its
+ * throughput along with percentiles of the per-address latency averaged within each chunk.
+ *
+ * usage: bench [addresses [rounds]]
+ */
+#include <postgres.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <base58check.h>
+#include <bech32.h>
+
+#include "../base58check21.h"
+#include "../bech32_batch.h"
+#include "../bitcoin_address.h"
+#include "../sha256.h"
+
+#define CHUNK_SIZE 256
+
+
+struct address_kind {
+	unsigned weight;
+	const char *name;
+	const char *hrp; // NULL for legacy addresses
+	uint8 version;
+	size_t n_program;
+	bool blech;
+};
+
+// weights are percentages of the corpus
+static const struct address_kind address_kinds[] = {
+	{ 34, "P2PKH", NULL, 0, 20, false },
+	{ 14, "P2SH", NULL, 5, 20, false },
+	{ 26, "P2WPKH", "bc", 0, 20, false },
+	{ 8, "P2WSH", "bc", 0, 32, false },
+	{ 10, "P2TR", "bc", 1, 32, false },
+	{ 2, "testnet P2PKH", NULL, 111, 20, false },
+	{ 2, "testnet P2WPKH", "tb", 0, 20, false },
+	{ 2, "Liquid blinded P2WPKH", "lq", 0, 53, true },
+	{ 1, "Liquid explicit P2WPKH", "ex", 0, 20, false },
+	{ 1, "Liquid blinded P2PKH", NULL, 12, 54, false },
+};
+
+struct sample {
+	struct bitcoin_address_fields f;
+	uint8 payload[1/*version*/ + 72];
+	char text[128];
+	size_t n_text;
+	bitcoin_address *packed;
+};
+
+static struct sample *samples;
+static size_t n_samples;
+static volatile size_t sink;
+
+static uint64
+splitmix64(uint64 *state)
+{
+	uint64 z = *state += UINT64_C(0x9E3779B97F4A7C15);
+	z = (z ^ z >> 30) * UINT64_C(0xBF58476D1CE4E5B9);
+	z = (z ^ z >> 27) * UINT64_C(0x94D049BB133111EB);
+	return z ^ z >> 31;
+}
+
+static void
+generate_corpus(void)
+{
+	uint64 rng = 0x5EED;
+	samples = palloc(n_samples * sizeof *samples);
+	for (size_t i = 0; i < n_samples; ++i) {
+		struct sample *s = &samples[i];
+		unsigned pick = (unsigned) (splitmix64(&rng) % 100);
+		const struct address_kind *kind = address_kinds;
+		while (pick >= kind->weight)
+			pick -= kind->weight, ++kind;
+
+		s->payload[0] = kind->version;
+		for (size_t j = 0; j < kind->n_program; ++j)
+			s->payload[1 + j] = (uint8) splitmix64(&rng);
+		s->f = (struct bitcoin_address_fields) {
+			.blech = kind->blech,
+			.version = kind->version,
+			.hrp = kind->hrp,
+			.n_hrp = kind->hrp ? strlen(kind->hrp) : 0,
+			.program = &s->payload[1],
+			.n_program = kind->n_program,
+		};
+		s->f.well_known_hrp_idx = kind->hrp ? (int) find_well_known_hrp(kind->hrp, s->f.n_hrp) : 0;
+
+		ssize_t n_text;
+		if (kind->hrp)
+			n_text = (kind->blech ? blech32_address_encode : bech32_address_encode)(s->text, sizeof s->text,
+					s->f.program, s->f.n_program, s->f.hrp, s->f.n_hrp, s->f.version);
+		else {
+			char *out = NULL;
+			size_t n_out = 0;
+			if ((n_text = base58check_encode(&out, &n_out, s->payload, 1 + kind->n_program, 0)) >= 0)
+				memcpy(s->text, out, (size_t) n_text), pfree(out);
+		}
+		if (n_text < 0) {
+			fprintf(stderr, "failed to encode a %s address\n", kind->name);
+			exit(EXIT_FAILURE);
+		}
+		s->n_text = (size_t) n_text;
+
+		size_t n_packed = packed_size(&s->f);
+		s->packed = palloc(n_packed);
+		pack(s->packed, &s->f);
+		SET_VARSIZE(s->packed, n_packed);
+	}
+}
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+static double
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+/*
+ * Runs a benchmark over the selected samples (or all samples if select is NULL) for the given number of rounds. The function is
+ * passed the indices of one chunk of samples and returns the number of addresses it processed.
+ */
+static void
+run(const char *name, size_t (*fn)(const size_t idx[], size_t n), bool (*select)(const struct sample *), unsigned rounds)
+{
+	size_t *idx = palloc(n_samples * sizeof *idx), n_selected = 0;
+	for (size_t i = 0; i < n_samples; ++i)
+		if (!select || (*select)(&samples[i]))
+			idx[n_selected++] = i;
+	if (n_selected == 0) {
+		pfree(idx);
+		return;
+	}
+
+	size_t n_chunks = (n_selected + CHUNK_SIZE - 1) / CHUNK_SIZE, n_latencies = 0, n_total = 0;
+	double *latencies = palloc(n_chunks * rounds * sizeof *latencies), elapsed = 0;
+	for (unsigned round = 0; round < rounds; ++round)
+		for (size_t begin = 0; begin < n_selected; begin += CHUNK_SIZE) {
+			size_t n = Min(CHUNK_SIZE, n_selected - begin);
+			double start = now_ns();
+			size_t n_done = (*fn)(&idx[begin], n);
+			double chunk_ns = now_ns() - start;
+			elapsed += chunk_ns, n_total += n_done;
+			latencies[n_latencies++] = chunk_ns / (double) Max(n_done, 1);
+		}
+	qsort(latencies, n_latencies, sizeof *latencies, &compare_doubles);
+
+	printf("%-28s %12.0f ops/s   p50 %8.1f ns   p90 %8.1f ns   p99 %8.1f ns\n",
+			name, (double) n_total / (elapsed / 1e9),
+			latencies[n_latencies * 50 / 100], latencies[n_latencies * 90 / 100], latencies[n_latencies * 99 / 100]);
+	pfree(latencies);
+	pfree(idx);
+}
+
+static bool is_legacy(const struct sample *s) { return !s->f.hrp; }
+static bool is_legacy21(const struct sample *s) { return !s->f.hrp && s->f.n_program + 1 == BASE58CHECK21_PAYLOAD_SIZE; }
+static bool is_bech32(const struct sample *s) { return s->f.hrp && !s->f.blech; }
+static bool is_blech32(const struct sample *s) { return s->f.hrp && s->f.blech; }
+static bool is_segwit(const struct sample *s) { return s->f.hrp; }
+
+
+static size_t
+bench_pack(const size_t idx[], size_t n)
+{
+	uint8 buffer[128];
+	for (size_t i = 0; i < n; ++i) {
+		const struct sample *s = &samples[idx[i]];
+		pack((bitcoin_address *) buffer, &s->f);
+		SET_VARSIZE(buffer, packed_size(&s->f));
+		sink += buffer[VARHDRSZ];
+	}
+	return n;
+}
+
+static size_t
+bench_unpack(const size_t idx[], size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		struct bitcoin_address_fields f;
+		unpack(&f, samples[idx[i]].packed);
+		sink += f.n_program;
+	}
+	return n;
+}
+
+static size_t
+bench_base58check21_encode(const size_t idx[], size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		char out[BASE58CHECK21_MAX_SIZE];
+		sink += base58check21_encode(out, samples[idx[i]].payload);
+	}
+	return n;
+}
+
+static size_t
+bench_base58check21_encode_batch(const size_t idx[], size_t n)
+{
+	const uint8 *in[CHUNK_SIZE];
+	char out[CHUNK_SIZE][BASE58CHECK21_MAX_SIZE];
+	size_t n_out[CHUNK_SIZE];
+	for (size_t i = 0; i < n; ++i)
+		in[i] = samples[idx[i]].payload;
+	base58check21_encode_batch(out, n_out, in, n);
+	sink += n_out[0];
+	return n;
+}
+
+static size_t
+bench_base58check21_decode(const size_t idx[], size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		uint8 out[BASE58CHECK21_PAYLOAD_SIZE];
+		sink += (size_t) base58check21_decode(out, samples[idx[i]].text, samples[idx[i]].n_text);
+	}
+	return n;
+}
+
+static size_t
+bench_base58check21_decode_batch(const size_t idx[], size_t n)
+{
+	const char *in[CHUNK_SIZE];
+	size_t n_in[CHUNK_SIZE];
+	uint8 out[CHUNK_SIZE][BASE58CHECK21_PAYLOAD_SIZE];
+	int ret[CHUNK_SIZE];
+	for (size_t i = 0; i < n; ++i)
+		in[i] = samples[idx[i]].text, n_in[i] = samples[idx[i]].n_text;
+	base58check21_decode_batch(out, ret, in, n_in, n);
+	sink += (size_t) ret[0];
+	return n;
+}
+
+static size_t
+bench_base58check_encode(const size_t idx[], size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		const struct sample *s = &samples[idx[i]];
+		char *out = NULL;
+		size_t n_out = 0;
+		if (base58check_encode(&out, &n_out, s->payload, 1 + s->f.n_program, 0) >= 0)
+			sink += n_out, pfree(out);
+	}
+	return n;
+}
+
+static size_t
+bench_base58check_decode(const size_t idx[], size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		const struct sample *s = &samples[idx[i]];
+		unsigned char *out = NULL;
+		size_t n_out = 0;
+		if (base58check_decode(&out, &n_out, s->text, s->n_text, 0) >= 0)
+			sink += n_out, pfree(out);
+	}
+	return n;
+}
+
+static size_t
+bench_segwit_encode(const size_t idx[], size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		const struct sample *s = &samples[idx[i]];
+		char out[128];
+		sink += (size_t) (s->f.blech ? blech32_address_encode : bech32_address_encode)(out, sizeof out,
+				s->f.program, s->f.n_program, s->f.hrp, s->f.n_hrp, s->f.version);
+	}
+	return n;
+}
+
+static size_t
+bench_segwit_encode_batch(const size_t idx[], size_t n)
+{
+	struct segwit_batch_entry entries[CHUNK_SIZE];
+	char out[CHUNK_SIZE][128];
+	for (size_t i = 0; i < n; ++i) {
+		const struct sample *s = &samples[idx[i]];
+		entries[i] = (struct segwit_batch_entry) {
+			.hrp = s->f.hrp, .n_hrp = s->f.n_hrp,
+			.program = s->f.program, .n_program = s->f.n_program,
+			.version = s->f.version, .blech = s->f.blech,
+			.out = out[i],
+		};
+	}
+	segwit_batch_encode(entries, n);
+	sink += (size_t) out[0][0];
+	return n;
+}
+
+static size_t
+bench_segwit_decode(const size_t idx[], size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		const struct sample *s = &samples[idx[i]];
+		uint8 program[128];
+		size_t n_hrp;
+		unsigned version;
+		sink += (size_t) (s->f.blech ? blech32_address_decode : bech32_address_decode)(program, s->f.n_program,
+				s->text, s->n_text, &n_hrp, &version);
+	}
+	return n;
+}
+
+static size_t
+bench_sha256d(const size_t idx[], size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		uint8 digest[SHA256_DIGEST_SIZE];
+		sha256d(digest, samples[idx[i]].payload, BASE58CHECK21_PAYLOAD_SIZE);
+		sink += digest[0];
+	}
+	return n;
+}
+
+static size_t
+bench_sha256d_batch(const size_t idx[], size_t n)
+{
+	const uint8 *in[CHUNK_SIZE];
+	uint8 digests[CHUNK_SIZE][SHA256_DIGEST_SIZE];
+	for (size_t i = 0; i < n; ++i)
+		in[i] = samples[idx[i]].payload;
+	sha256d_batch(digests, in, BASE58CHECK21_PAYLOAD_SIZE, n);
+	sink += digests[0][0];
+	return n;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	n_samples = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+	unsigned rounds = argc > 2 ? (unsigned) strtoul(argv[2], NULL, 10) : 10;
+	if (n_samples == 0 || rounds == 0) {
+		fprintf(stderr, "usage: %s [addresses [rounds]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// as at module load
+	sha256_init();
+	bech32_batch_init();
+
+	generate_corpus();
+	printf("%zu addresses, %u rounds, chunks of %d\n\n", n_samples, rounds, CHUNK_SIZE);
+
+	run("pack", &bench_pack, NULL, rounds);
+	run("unpack", &bench_unpack, NULL, rounds);
+	run("sha256d (21 bytes)", &bench_sha256d, &is_legacy21, rounds);
+	run("sha256d_batch (21 bytes)", &bench_sha256d_batch, &is_legacy21, rounds);
+	run("base58check21_encode", &bench_base58check21_encode, &is_legacy21, rounds);
+	run("base58check21_encode_batch", &bench_base58check21_encode_batch, &is_legacy21, rounds);
+	run("base58check21_decode", &bench_base58check21_decode, &is_legacy21, rounds);
+	run("base58check21_decode_batch", &bench_base58check21_decode_batch, &is_legacy21, rounds);
+	run("base58check_encode (lib)", &bench_base58check_encode, &is_legacy, rounds);
+	run("base58check_decode (lib)", &bench_base58check_decode, &is_legacy, rounds);
+	run("bech32 encode (lib)", &bench_segwit_encode, &is_bech32, rounds);
+	run("bech32 decode (lib)", &bench_segwit_decode, &is_bech32, rounds);
+	run("blech32 encode (lib)", &bench_segwit_encode, &is_blech32, rounds);
+	run("blech32 decode (lib)", &bench_segwit_decode, &is_blech32, rounds);
+	run("segwit_batch_encode", &bench_segwit_encode_batch, &is_segwit, rounds);
+	return EXIT_SUCCESS;
+}
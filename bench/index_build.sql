@@ -0,0 +1,3 @@
+-- B-tree index build over bitcoin_address (exercises sort support with abbreviated keys).
+DROP INDEX IF EXISTS bench_index_build_idx;
+CREATE INDEX bench_index_build_idx ON bench_addresses (address);
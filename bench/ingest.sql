@@ -0,0 +1,3 @@
+-- COPY ingest: parses every textual address of the corpus into bitcoin_address.
+TRUNCATE bench_ingest;
+COPY bench_ingest FROM '/tmp/pg_bitcoin_address_bench_corpus.tsv';
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Runs the pgbench workloads against the database named by the usual libpq environment variables and prints the throughput and
+# latency percentiles of each. COPY ingest reads a server-side file, which requires superuser or pg_read_server_files.
+#
+# usage: bench/pgbench.sh [rows [seconds [clients]]]
+
+set -e
+rows=${1:-1000000}
+seconds=${2:-30}
+clients=${3:-1}
+dir=$(dirname "$0")
+logdir=$(mktemp -d)
+trap 'rm -rf "$logdir"' EXIT
+
+psql -X -q -v ON_ERROR_STOP=1 -v rows="$rows" -f "$dir/setup.sql"
+
+run() {
+	name=$1 script=$2 c=$3
+	rm -f "$logdir"/*
+	tps=$(pgbench -n -f "$dir/$script" -D rows="$rows" -T "$seconds" -c "$c" -j "$c" -l --log-prefix="$logdir/log" 2>&1 |
+		sed -n 's/^tps = \([0-9.]*\).*/\1/p')
+	# the third field of each transaction log line is its latency in microseconds
+	cat "$logdir"/log* | awk '{ print $3 }' | sort -n | awk -v name="$name" -v tps="$tps" '
+		{ lat[NR] = $1 }
+		END {
+			if (NR == 0) exit 1
+			printf "%-16s %10.1f tps   p50 %10.3f ms   p90 %10.3f ms   p99 %10.3f ms\n", name, tps,
+				lat[int(NR * 0.50) + 1] / 1000, lat[int(NR * 0.90) + 1] / 1000, lat[int(NR * 0.99) + 1] / 1000
+		}'
+}
+
+run "COPY ingest" ingest.sql 1
+run "text parse" text_parse.sql "$clients"
+run "index build" index_build.sql 1
+run "point lookup" point_lookup.sql "$clients"
+run "type aggregate" type_aggregate.sql "$clients"
@@ -0,0 +1,4 @@
+-- Point lookup of a random address given as text.
+\set id random(1, :rows)
+SELECT a.id FROM bench_addresses AS a
+WHERE a.address = (SELECT c.address_text FROM bench_corpus AS c WHERE c.id = :id)::bitcoin_address;
@@ -0,0 +1,41 @@
+-- Creates the tables used by the pgbench scripts. Run with psql -v rows=N (default 1000000).
+-- The synthetic corpus is deterministic and mixes networks and address types in roughly the proportions seen on chain.
+
+\if :{?rows}
+\else
+\set rows 1000000
+\endif
+
+CREATE EXTENSION IF NOT EXISTS pg_bitcoin_address;
+
+DROP TABLE IF EXISTS bench_corpus, bench_addresses, bench_ingest;
+
+CREATE TABLE bench_corpus (id integer PRIMARY KEY, address_text text NOT NULL);
+
+INSERT INTO bench_corpus
+SELECT i, CASE
+		WHEN k < 34 THEN bitcoin_address(NULL, 0, h20) -- P2PKH
+		WHEN k < 48 THEN bitcoin_address(NULL, 5, h20) -- P2SH
+		WHEN k < 74 THEN bitcoin_address('bc', 0, h20) -- P2WPKH
+		WHEN k < 82 THEN bitcoin_address('bc', 0, h32) -- P2WSH
+		WHEN k < 92 THEN bitcoin_address('bc', 1, h32) -- P2TR
+		WHEN k < 94 THEN bitcoin_address(NULL, 111, h20) -- testnet P2PKH
+		WHEN k < 96 THEN bitcoin_address('tb', 0, h20) -- testnet P2WPKH
+		WHEN k < 98 THEN bitcoin_address('lq', 0, '\x02'::bytea || h32 || h20) -- Liquid blinded P2WPKH
+		WHEN k < 99 THEN bitcoin_address('ex', 0, h20) -- Liquid explicit P2WPKH
+		ELSE bitcoin_address(NULL, 12, '\x3902'::bytea || h32 || h20) -- Liquid blinded P2PKH
+	END::text
+FROM generate_series(1, :rows) AS i,
+	LATERAL (SELECT sha256(int4send(i)) AS h32) AS h,
+	LATERAL (SELECT (hashint4(i) & 0x7FFFFFFF) % 100 AS k, substr(h32, 1, 20) AS h20) AS x;
+
+CREATE TABLE bench_addresses (id integer PRIMARY KEY, address bitcoin_address NOT NULL);
+INSERT INTO bench_addresses SELECT id, address_text::bitcoin_address FROM bench_corpus;
+CREATE INDEX bench_addresses_address_idx ON bench_addresses (address);
+
+CREATE UNLOGGED TABLE bench_ingest (id integer, address bitcoin_address);
+
+-- COPY ingest reads the corpus from this file on the server
+COPY bench_corpus TO '/tmp/pg_bitcoin_address_bench_corpus.tsv';
+
+VACUUM ANALYZE bench_corpus, bench_addresses;
@@ -0,0 +1,123 @@
+/*
+ * Just enough of the PostgreSQL backend for the extension's standalone code paths to run outside of a server: memory is
+ * allocated with malloc, and any error aborts the benchmark.
+ */
+#include <postgres.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+void *
+palloc(Size size)
+{
+	void *ptr = malloc(size ?: 1);
+	if (!ptr)
+		abort();
+	return ptr;
+}
+
+void *
+palloc0(Size size)
+{
+	return memset(palloc(size), 0, size);
+}
+
+void *
+repalloc(void *pointer, Size size)
+{
+	void *ptr = realloc(pointer, size ?: 1);
+	if (!ptr)
+		abort();
+	return ptr;
+}
+
+void
+pfree(void *pointer)
+{
+	free(pointer);
+}
+
+void * base58check_malloc(size_t size);
+void base58check_free(void *ptr);
+
+void *
+base58check_malloc(size_t size)
+{
+	return palloc(size);
+}
+
+void
+base58check_free(void *ptr)
+{
+	pfree(ptr);
+}
+
+bool
+errstart(int elevel, const char *domain)
+{
+	(void) domain;
+	return elevel >= ERROR;
+}
+
+bool
+errstart_cold(int elevel, const char *domain)
+{
+	return errstart(elevel, domain);
+}
+
+int
+errcode(int sqlerrcode)
+{
+	(void) sqlerrcode;
+	return 0;
+}
+
+int
+errmsg(const char *fmt, ...)
+{
+	fprintf(stderr, "error: %s\n", fmt);
+	return 0;
+}
+
+int
+errmsg_internal(const char *fmt, ...)
+{
+	return errmsg(fmt);
+}
+
+int
+errdetail_internal(const char *fmt, ...)
+{
+	(void) fmt;
+	return 0;
+}
+
+int
+errhint(const char *fmt, ...)
+{
+	(void) fmt;
+	return 0;
+}
+
+void
+errfinish(const char *filename, int lineno, const char *funcname)
+{
+	fprintf(stderr, "%s:%d: error raised in %s\n", filename, lineno, funcname);
+	abort();
+}
+
+#include "../hrp_registry.h"
+
+ssize_t
+hrp_registry_find(const char *hrp, size_t n_hrp)
+{
+	(void) hrp, (void) n_hrp;
+	return -1;
+}
+
+const char *
+hrp_registry_hrp(size_t idx, size_t *n_hrp)
+{
+	(void) idx, (void) n_hrp;
+	return NULL;
+}
@@ -0,0 +1,3 @@
+-- Input parsing of a random block of textual addresses, without the file I/O of COPY.
+\set id random(1, :rows)
+SELECT count(address_text::bitcoin_address) FROM bench_corpus WHERE id BETWEEN :id AND :id + 9999;
@@ -0,0 +1,5 @@
+-- Aggregates filtered and grouped by classification, formatting the addresses as text.
+SELECT network(address), address_type(address), count(*), min(address::text), max(address::text)
+FROM bench_addresses
+WHERE is_p2wpkh(address) OR is_p2tr(address)
+GROUP BY 1, 2;
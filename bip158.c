@@ -0,0 +1,429 @@
+#include <postgres.h>
+#include <fmgr.h>
+
+#include <catalog/pg_type.h>
+#include <utils/array.h>
+#include <utils/builtins.h>
+#include <utils/lsyscache.h>
+
+#include "bitcoin_address.h"
+
+
+/*
+ * BIP158 basic block filters are Golomb-coded sets of the scriptPubKeys that a block creates or spends. Each distinct script is
+ * hashed with SipHash-2-4, keyed by the first 16 bytes of the block hash, and the hash is mapped uniformly onto [0, N * M), where N
+ * is the number of distinct scripts. The sorted mapped values are delta-coded with a Golomb-Rice code of parameter P, most
+ * significant bit first, and the filter is the CompactSize encoding of N followed by the code.
+ */
+#define GCS_P 19
+#define GCS_M UINT64CONST(784931)
+#define BLOCK_HASH_SIZE 32
+
+struct gcs_key {
+	uint64 k0, k1;
+};
+
+static inline uint64
+load_le64(const uint8 *in)
+{
+	uint64 v = 0;
+	for (size_t i = 0; i < 8; ++i)
+		v |= (uint64) in[i] << (8 * i);
+	return v;
+}
+
+#define ROTL64(x, b) ((x) << (b) | (x) >> (64 - (b)))
+#define SIPROUND do { \
+		v0 += v1, v1 = ROTL64(v1, 13), v1 ^= v0, v0 = ROTL64(v0, 32); \
+		v2 += v3, v3 = ROTL64(v3, 16), v3 ^= v2; \
+		v0 += v3, v3 = ROTL64(v3, 21), v3 ^= v0; \
+		v2 += v1, v1 = ROTL64(v1, 17), v1 ^= v2, v2 = ROTL64(v2, 32); \
+	} while (0)
+
+static uint64 __attribute__ ((__pure__))
+siphash24(const struct gcs_key *key, const uint8 *in, size_t n_in)
+{
+	uint64 v0 = UINT64CONST(0x736F6D6570736575) ^ key->k0, v1 = UINT64CONST(0x646F72616E646F6D) ^ key->k1,
+			v2 = UINT64CONST(0x6C7967656E657261) ^ key->k0, v3 = UINT64CONST(0x7465646279746573) ^ key->k1;
+	size_t i = 0;
+	for (; i + 8 <= n_in; i += 8) {
+		uint64 m = load_le64(&in[i]);
+		v3 ^= m;
+		SIPROUND;
+		SIPROUND;
+		v0 ^= m;
+	}
+	uint64 b = (uint64) n_in << 56;
+	for (size_t j = 0; i + j < n_in; ++j)
+		b |= (uint64) in[i + j] << (8 * j);
+	v3 ^= b;
+	SIPROUND;
+	SIPROUND;
+	v0 ^= b;
+	v2 ^= 0xFF;
+	SIPROUND;
+	SIPROUND;
+	SIPROUND;
+	SIPROUND;
+	return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// maps a hash uniformly onto [0, f)
+static inline uint64
+map_hash(uint64 hash, uint64 f)
+{
+	return (uint64) ((unsigned __int128) hash * f >> 64);
+}
+
+static struct gcs_key
+getarg_gcs_key(FunctionCallInfo fcinfo, int n)
+{
+	const bytea *arg = PG_GETARG_BYTEA_PP(n);
+	if (_unlikely(VARSIZE_ANY_EXHDR(arg) != BLOCK_HASH_SIZE))
+		ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				errmsg("block hash must be %d bytes", BLOCK_HASH_SIZE));
+	const uint8 *data = (const uint8 *) VARDATA_ANY(arg);
+	return (struct gcs_key) { load_le64(data), load_le64(data + 8) };
+}
+
+// returns the SipHash of the scriptPubKey of an address, or false if the address has no known scriptPubKey
+static bool
+address_script_hash(uint64 *hash, const struct gcs_key *key, const bitcoin_address *arg)
+{
+	struct bitcoin_address_fields f;
+	unpack(&f, arg);
+	uint8 script[SCRIPT_PUBKEY_MAX_SIZE];
+	size_t n_script = script_pubkey(script, &f);
+	if (!n_script)
+		return false;
+	*hash = siphash24(key, script, n_script);
+	return true;
+}
+
+static int
+uint64_cmp(const void *a, const void *b)
+{
+	uint64 x = *(const uint64 *) a, y = *(const uint64 *) b;
+	return (x > y) - (x < y);
+}
+
+
+struct bit_writer {
+	uint8 *data;
+	size_t n_bits;
+};
+
+static inline void
+write_bits(struct bit_writer *w, uint64 value, int n)
+{
+	while (n-- > 0) {
+		if (value >> n & 1)
+			w->data[w->n_bits >> 3] |= (uint8) (0x80 >> (w->n_bits & 7));
+		++w->n_bits;
+	}
+}
+
+struct bit_reader {
+	const uint8 *data;
+	size_t n_bits, pos;
+};
+
+static inline uint64
+read_bit(struct bit_reader *r)
+{
+	if (_unlikely(r->pos >= r->n_bits))
+		ereport(ERROR, errcode(ERRCODE_DATA_CORRUPTED),
+				errmsg("block filter is truncated"));
+	uint64 bit = r->data[r->pos >> 3] >> (7 - (r->pos & 7)) & 1;
+	++r->pos;
+	return bit;
+}
+
+static inline uint64
+golomb_rice_decode(struct bit_reader *r)
+{
+	uint64 q = 0;
+	while (read_bit(r))
+		++q;
+	uint64 rem = 0;
+	for (int i = 0; i < GCS_P; ++i)
+		rem = rem << 1 | read_bit(r);
+	return q << GCS_P | rem;
+}
+
+static size_t
+compact_size_size(uint64 n)
+{
+	return n < 0xFD ? 1 : n <= 0xFFFF ? 3 : n <= 0xFFFFFFFF ? 5 : 9;
+}
+
+static uint8 *
+write_compact_size(uint8 *out, uint64 n)
+{
+	size_t n_bytes = compact_size_size(n) - 1;
+	if (n_bytes)
+		*out++ = n_bytes == 2 ? 0xFD : n_bytes == 4 ? 0xFE : 0xFF;
+	else
+		n_bytes = 1;
+	for (size_t i = 0; i < n_bytes; ++i)
+		*out++ = (uint8) (n >> (8 * i));
+	return out;
+}
+
+static size_t
+read_compact_size(uint64 *n, const uint8 *in, size_t n_in)
+{
+	if (_unlikely(n_in < 1))
+		goto truncated;
+	size_t n_bytes = in[0] < 0xFD ? 0 : (size_t) 1 << (in[0] - 0xFC);
+	if (_unlikely(n_in < 1 + n_bytes))
+		goto truncated;
+	if (!n_bytes) {
+		*n = in[0];
+		return 1;
+	}
+	*n = 0;
+	for (size_t i = 0; i < n_bytes; ++i)
+		*n |= (uint64) in[1 + i] << (8 * i);
+	return 1 + n_bytes;
+
+truncated:
+	ereport(ERROR, errcode(ERRCODE_DATA_CORRUPTED),
+			errmsg("block filter is truncated"));
+}
+
+
+/*
+ * The transition state of the filter aggregates is the SipHash key and the hashes of the scripts seen so far. Its serialized form
+ * is the key followed by the hashes, all in host byte order, which suffices between the processes of a parallel query.
+ */
+struct gcs_state {
+	struct gcs_key key;
+	size_t n_hashes, capacity;
+	uint64 *hashes;
+};
+
+static MemoryContext
+aggregate_context(FunctionCallInfo fcinfo, const char *funcname)
+{
+	MemoryContext aggcontext;
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "%s called in non-aggregate context", funcname);
+	return aggcontext;
+}
+
+static struct gcs_state *
+gcs_state_create(MemoryContext aggcontext, struct gcs_key key, size_t capacity)
+{
+	struct gcs_state *state = MemoryContextAlloc(aggcontext, sizeof *state);
+	state->key = key;
+	state->n_hashes = 0;
+	state->capacity = Max(capacity, 64);
+	state->hashes = MemoryContextAllocHuge(aggcontext, state->capacity * sizeof *state->hashes);
+	return state;
+}
+
+static void
+gcs_state_reserve(struct gcs_state *state, size_t n)
+{
+	if (state->n_hashes + n > state->capacity) {
+		state->capacity = Max(state->capacity * 2, state->n_hashes + n);
+		state->hashes = repalloc_huge(state->hashes, state->capacity * sizeof *state->hashes);
+	}
+}
+
+static void
+check_same_key(const struct gcs_state *state, struct gcs_key key)
+{
+	if (_unlikely(state->key.k0 != key.k0 || state->key.k1 != key.k1))
+		ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				errmsg("block hash must be the same in every row"));
+}
+
+// returns the transition state for a row, with room for one more hash
+static struct gcs_state *
+gcs_state_for_row(FunctionCallInfo fcinfo, MemoryContext aggcontext)
+{
+	struct gcs_state *state = PG_ARGISNULL(0) ? NULL : (struct gcs_state *) PG_GETARG_POINTER(0);
+	if (PG_ARGISNULL(2))
+		ereport(ERROR, errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				errmsg("block hash must not be null"));
+	struct gcs_key key = getarg_gcs_key(fcinfo, 2);
+	if (!state)
+		state = gcs_state_create(aggcontext, key, 0);
+	else
+		check_same_key(state, key);
+	gcs_state_reserve(state, 1);
+	return state;
+}
+
+PG_FUNCTION_INFO_V1(pg_bip158_filter_add_address);
+Datum
+pg_bip158_filter_add_address(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext = aggregate_context(fcinfo, "bip158_filter_add_address");
+	struct gcs_state *state = gcs_state_for_row(fcinfo, aggcontext);
+	if (!PG_ARGISNULL(1) &&
+			address_script_hash(&state->hashes[state->n_hashes], &state->key, PG_GETARG_VARLENA_PP(1)))
+		++state->n_hashes;
+	PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(pg_bip158_filter_add_script);
+Datum
+pg_bip158_filter_add_script(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext = aggregate_context(fcinfo, "bip158_filter_add_script");
+	struct gcs_state *state = gcs_state_for_row(fcinfo, aggcontext);
+	if (!PG_ARGISNULL(1)) {
+		// empty scripts and OP_RETURN outputs, such as witness commitments, are excluded from filters
+		const bytea *script = PG_GETARG_BYTEA_PP(1);
+		if (VARSIZE_ANY_EXHDR(script) > 0 && (uint8) VARDATA_ANY(script)[0] != 0x6a/*OP_RETURN*/)
+			state->hashes[state->n_hashes++] = siphash24(&state->key, (const uint8 *) VARDATA_ANY(script),
+					VARSIZE_ANY_EXHDR(script));
+	}
+	PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(pg_bip158_filter_combine);
+Datum
+pg_bip158_filter_combine(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext = aggregate_context(fcinfo, "bip158_filter_combine");
+	struct gcs_state *state = PG_ARGISNULL(0) ? NULL : (struct gcs_state *) PG_GETARG_POINTER(0);
+	const struct gcs_state *other = PG_ARGISNULL(1) ? NULL : (const struct gcs_state *) PG_GETARG_POINTER(1);
+	if (!other) {
+		if (!state)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
+	}
+	if (!state)
+		state = gcs_state_create(aggcontext, other->key, other->n_hashes);
+	else
+		check_same_key(state, other->key);
+	gcs_state_reserve(state, other->n_hashes);
+	memcpy(&state->hashes[state->n_hashes], other->hashes, other->n_hashes * sizeof *other->hashes);
+	state->n_hashes += other->n_hashes;
+	PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(pg_bip158_filter_serialize);
+Datum
+pg_bip158_filter_serialize(PG_FUNCTION_ARGS)
+{
+	const struct gcs_state *state = (const struct gcs_state *) PG_GETARG_POINTER(0);
+	size_t n_out = VARHDRSZ + sizeof state->key + state->n_hashes * sizeof *state->hashes;
+	bytea *out = palloc(n_out);
+	SET_VARSIZE(out, n_out);
+	memcpy(VARDATA(out), &state->key, sizeof state->key);
+	memcpy(VARDATA(out) + sizeof state->key, state->hashes, state->n_hashes * sizeof *state->hashes);
+	PG_RETURN_BYTEA_P(out);
+}
+
+PG_FUNCTION_INFO_V1(pg_bip158_filter_deserialize);
+Datum
+pg_bip158_filter_deserialize(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext = aggregate_context(fcinfo, "bip158_filter_deserialize");
+	const bytea *arg = PG_GETARG_BYTEA_PP(0);
+	struct gcs_key key;
+	memcpy(&key, VARDATA_ANY(arg), sizeof key);
+	size_t n_hashes = (VARSIZE_ANY_EXHDR(arg) - sizeof key) / sizeof(uint64);
+	struct gcs_state *state = gcs_state_create(aggcontext, key, n_hashes);
+	memcpy(state->hashes, VARDATA_ANY(arg) + sizeof key, n_hashes * sizeof *state->hashes);
+	state->n_hashes = n_hashes;
+	PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(pg_bip158_filter_final);
+Datum
+pg_bip158_filter_final(PG_FUNCTION_ARGS)
+{
+	struct gcs_state *state = (struct gcs_state *) PG_GETARG_POINTER(0);
+
+	// Distinct scripts have distinct hashes (barring a 64-bit collision), and the mapping onto [0, N * M) preserves order.
+	qsort(state->hashes, state->n_hashes, sizeof *state->hashes, uint64_cmp);
+	size_t n = 0;
+	for (size_t i = 0; i < state->n_hashes; ++i)
+		if (n == 0 || state->hashes[i] != state->hashes[n - 1])
+			state->hashes[n++] = state->hashes[i];
+	uint64 f = n * GCS_M;
+	size_t n_bits = 0;
+	uint64 last = 0;
+	for (size_t i = 0; i < n; ++i) {
+		uint64 value = map_hash(state->hashes[i], f);
+		n_bits += ((value - last) >> GCS_P) + 1 + GCS_P;
+		last = value;
+	}
+
+	size_t n_out = VARHDRSZ + compact_size_size(n) + (n_bits + 7) / 8;
+	bytea *out = palloc0(n_out);
+	SET_VARSIZE(out, n_out);
+	struct bit_writer w = { write_compact_size((uint8 *) VARDATA(out), n), 0 };
+	last = 0;
+	for (size_t i = 0; i < n; ++i) {
+		uint64 value = map_hash(state->hashes[i], f), delta = value - last;
+		for (uint64 q = delta >> GCS_P; q > 0; --q)
+			write_bits(&w, 1, 1);
+		write_bits(&w, 0, 1);
+		write_bits(&w, delta, GCS_P);
+		last = value;
+	}
+	PG_RETURN_BYTEA_P(out);
+}
+
+
+/*
+ * Matches any of many addresses against a filter in one pass: the query values are mapped and sorted, and the filter is decoded
+ * only as far as the first match.
+ */
+PG_FUNCTION_INFO_V1(pg_gcs_match_any);
+Datum
+pg_gcs_match_any(PG_FUNCTION_ARGS)
+{
+	const bytea *filter = PG_GETARG_BYTEA_PP(0);
+	struct gcs_key key = getarg_gcs_key(fcinfo, 1);
+	ArrayType *addresses = PG_GETARG_ARRAYTYPE_P(2);
+
+	const uint8 *data = (const uint8 *) VARDATA_ANY(filter);
+	size_t n_data = VARSIZE_ANY_EXHDR(filter);
+	uint64 n;
+	size_t n_header = read_compact_size(&n, data, n_data);
+	if (n == 0)
+		PG_RETURN_BOOL(false);
+	if (_unlikely(n > (n_data - n_header) * 8 / (1 + GCS_P)))
+		ereport(ERROR, errcode(ERRCODE_DATA_CORRUPTED),
+				errmsg("block filter is truncated"));
+	uint64 f = n * GCS_M;
+
+	int16 typlen;
+	bool typbyval;
+	char typalign;
+	get_typlenbyvalalign(ARR_ELEMTYPE(addresses), &typlen, &typbyval, &typalign);
+	Datum *elems;
+	bool *nulls;
+	int n_elems;
+	deconstruct_array(addresses, ARR_ELEMTYPE(addresses), typlen, typbyval, typalign, &elems, &nulls, &n_elems);
+	uint64 *queries = palloc(Max(n_elems, 1) * sizeof *queries);
+	size_t n_queries = 0;
+	for (int i = 0; i < n_elems; ++i)
+		if (!nulls[i] && address_script_hash(&queries[n_queries], &key, (const bitcoin_address *) PG_DETOAST_DATUM_PACKED(elems[i])))
+			queries[n_queries] = map_hash(queries[n_queries], f), ++n_queries;
+	if (n_queries == 0)
+		PG_RETURN_BOOL(false);
+	qsort(queries, n_queries, sizeof *queries, uint64_cmp);
+
+	struct bit_reader r = { data + n_header, (n_data - n_header) * 8, 0 };
+	uint64 value = 0;
+	size_t j = 0;
+	for (uint64 i = 0; i < n; ++i) {
+		value += golomb_rice_decode(&r);
+		while (queries[j] <= value) {
+			if (queries[j] == value)
+				PG_RETURN_BOOL(true);
+			if (++j == n_queries)
+				PG_RETURN_BOOL(false);
+		}
+	}
+	PG_RETURN_BOOL(false);
+}
@@ -0,0 +1,276 @@
+#include <postgres.h>
+#include <fmgr.h>
+#include <funcapi.h>
+#include <miscadmin.h>
+
+#include <utils/builtins.h>
+#include <utils/tuplestore.h>
+
+#include <secp256k1.h>
+#include <secp256k1_extrakeys.h>
+
+#include "bip32.h"
+#include "bitcoin_address.h"
+#include "ripemd160.h"
+#include "sha256.h"
+#include "sha512.h"
+
+
+/*
+ * BIP32 public derivation: the child of a node at a non-hardened index is found by keying HMAC-SHA-512 with the node's chain code
+ * and hashing its compressed public key and the index. The left half of the digest, times the generator, is added to the node's
+ * public key, and the right half is the child's chain code. Nodes therefore hold their chain codes as prepared HMAC keys.
+ *
+ * The node at the end of a derivation path is cached in fn_extra, so a query that scans consecutive ranges of indices under the
+ * same extended key and path derives the path only once and then pays for one child derivation per address.
+ */
+#define EXTENDED_KEY_SIZE 78
+#define EXTENDED_KEY_CHAIN_CODE_OFFSET 13
+#define EXTENDED_KEY_KEY_OFFSET 45
+#define CHAIN_CODE_SIZE 32
+#define PUBKEY_SIZE 33
+#define XONLY_PUBKEY_SIZE 32
+#define HARDENED_INDEX UINT32_C(0x80000000)
+
+// versions of extended public keys, including the SLIP-0132 versions that imply an address type
+static const struct {
+	uint32 version;
+	enum address_network network;
+} extended_public_key_versions[] = {
+	{ 0x0488B21E, ADDRESS_NETWORK_MAINNET }, // xpub
+	{ 0x049D7CB2, ADDRESS_NETWORK_MAINNET }, // ypub
+	{ 0x04B24746, ADDRESS_NETWORK_MAINNET }, // zpub
+	{ 0x043587CF, ADDRESS_NETWORK_TESTNET }, // tpub
+	{ 0x044A5262, ADDRESS_NETWORK_TESTNET }, // upub
+	{ 0x045F1CF6, ADDRESS_NETWORK_TESTNET }, // vpub
+};
+
+struct bip32_node {
+	secp256k1_pubkey pubkey;
+	uint8 serialized[PUBKEY_SIZE];
+	struct hmac_sha512_key chain_code;
+};
+
+struct derivation_cache {
+	bool valid;
+	uint8 extended_key[EXTENDED_KEY_SIZE];
+	char *path; // allocated in fn_mcxt
+	size_t n_path;
+	enum address_network network;
+	struct bip32_node node; // at the end of the path
+	struct enum_label_cache type; // the address type requested last
+};
+
+static struct derivation_cache *
+get_derivation_cache(FunctionCallInfo fcinfo)
+{
+	if (_unlikely(!fcinfo->flinfo->fn_extra))
+		fcinfo->flinfo->fn_extra = MemoryContextAllocZero(fcinfo->flinfo->fn_mcxt, sizeof(struct derivation_cache));
+	return fcinfo->flinfo->fn_extra;
+}
+
+void
+bip32_init(void)
+{
+	secp256k1_selftest();
+}
+
+/*
+ * Derives the public key of the child at a non-hardened index and, if chain_code is not NULL, its chain code. Returns false if
+ * the index yields no valid key, which happens with probability below 2^-127; BIP32 then skips the index.
+ */
+static bool
+derive_child(secp256k1_pubkey *pubkey, uint8 chain_code[CHAIN_CODE_SIZE], const struct bip32_node *parent, uint32 index)
+{
+	uint8 data[PUBKEY_SIZE + sizeof index], digest[SHA512_DIGEST_SIZE];
+	memcpy(data, parent->serialized, PUBKEY_SIZE);
+	for (size_t i = 0; i < sizeof index; ++i)
+		data[PUBKEY_SIZE + i] = (uint8) (index >> (8 * (sizeof index - 1 - i)));
+	hmac_sha512(digest, &parent->chain_code, data, sizeof data);
+	*pubkey = parent->pubkey;
+	if (!secp256k1_ec_pubkey_tweak_add(secp256k1_context_static, pubkey, digest))
+		return false;
+	if (chain_code)
+		memcpy(chain_code, &digest[SHA512_DIGEST_SIZE - CHAIN_CODE_SIZE], CHAIN_CODE_SIZE);
+	return true;
+}
+
+static void
+set_node(struct bip32_node *node, const secp256k1_pubkey *pubkey, const uint8 chain_code[CHAIN_CODE_SIZE])
+{
+	size_t n_serialized = sizeof node->serialized;
+	node->pubkey = *pubkey;
+	secp256k1_ec_pubkey_serialize(secp256k1_context_static, node->serialized, &n_serialized, pubkey, SECP256K1_EC_COMPRESSED);
+	hmac_sha512_init(&node->chain_code, chain_code, CHAIN_CODE_SIZE);
+}
+
+// returns the cached node at the end of the given path under the given extended public key, deriving it if necessary
+static const struct derivation_cache *
+derivation_node(FunctionCallInfo fcinfo, const struct varlena *extended_key, const text *path)
+{
+	const uint8 *key = (const uint8 *) VARDATA_ANY(extended_key);
+	const char *p = VARDATA_ANY(path);
+	size_t n_key = VARSIZE_ANY_EXHDR(extended_key), n_path = VARSIZE_ANY_EXHDR(path);
+
+	struct derivation_cache *cache = get_derivation_cache(fcinfo);
+	if (_likely(cache->valid) && n_key == EXTENDED_KEY_SIZE && memcmp(key, cache->extended_key, n_key) == 0 &&
+			n_path == cache->n_path && memcmp(p, cache->path, n_path) == 0)
+		return cache;
+	cache->valid = false;
+
+	if (_unlikely(n_key != EXTENDED_KEY_SIZE))
+		ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				errmsg("extended public key must be %d bytes, not %zu", EXTENDED_KEY_SIZE, n_key));
+	uint32 version = (uint32) key[0] << 24 | (uint32) key[1] << 16 | (uint32) key[2] << 8 | key[3];
+	size_t i = 0;
+	while (i < sizeof extended_public_key_versions / sizeof *extended_public_key_versions &&
+			extended_public_key_versions[i].version != version)
+		++i;
+	if (_unlikely(i == sizeof extended_public_key_versions / sizeof *extended_public_key_versions))
+		ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				key[EXTENDED_KEY_KEY_OFFSET] == 0x00 ?
+					errmsg("extended key is a private key") : errmsg("extended public key has unknown version 0x%08X", version),
+				errhint("The key must be an xpub, ypub, zpub, tpub, upub, or vpub."));
+	cache->network = extended_public_key_versions[i].network;
+	secp256k1_pubkey pubkey;
+	if (_unlikely(!secp256k1_ec_pubkey_parse(secp256k1_context_static, &pubkey, &key[EXTENDED_KEY_KEY_OFFSET], PUBKEY_SIZE)))
+		ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				errmsg("extended public key holds an invalid public key"));
+	set_node(&cache->node, &pubkey, &key[EXTENDED_KEY_CHAIN_CODE_OFFSET]);
+
+	// the path is a possibly empty sequence of non-hardened indices separated by slashes
+	for (size_t pos = 0; pos < n_path;) {
+		uint64 index = 0;
+		size_t start = pos;
+		while (pos < n_path && p[pos] >= '0' && p[pos] <= '9' && index < HARDENED_INDEX)
+			index = index * 10 + (uint64) (p[pos++] - '0');
+		if (_unlikely(pos < n_path && (p[pos] == '\'' || p[pos] == 'h' || p[pos] == 'H')))
+			ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					errmsg("hardened derivation requires a private key"));
+		if (_unlikely(pos == start || index >= HARDENED_INDEX || pos < n_path && (p[pos] != '/' || ++pos == n_path)))
+			ereport(ERROR, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+					errmsg("invalid derivation path: \"%.*s\"", (int) n_path, p),
+					errhint("The path must consist of indices below 2147483648 separated by slashes, such as \"0\" or \"1/5\"."));
+		uint8 chain_code[CHAIN_CODE_SIZE];
+		if (_unlikely(!derive_child(&pubkey, chain_code, &cache->node, (uint32) index)))
+			ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					errmsg("derivation path leads to an invalid key"));
+		set_node(&cache->node, &pubkey, chain_code);
+	}
+
+	memcpy(cache->extended_key, key, EXTENDED_KEY_SIZE);
+	if (cache->path)
+		pfree(cache->path);
+	cache->path = MemoryContextAlloc(fcinfo->flinfo->fn_mcxt, Max(n_path, 1));
+	memcpy(cache->path, p, n_path);
+	cache->n_path = n_path;
+	cache->valid = true;
+	return cache;
+}
+
+// returns the address of the given type that pays to the given key, or NULL in the negligible case that a P2TR tweak fails
+static bitcoin_address *
+pubkey_address(const secp256k1_pubkey *pubkey, enum address_type type, enum address_network network)
+{
+	uint8 key[PUBKEY_SIZE], script[SCRIPT_PUBKEY_MAX_SIZE];
+	size_t n_key = sizeof key, n_script;
+	if (type == ADDRESS_TYPE_P2TR) {
+		// BIP86: the output key commits to the internal key and to no script tree
+		secp256k1_xonly_pubkey internal, output;
+		secp256k1_pubkey tweaked;
+		uint8 tag[SHA256_DIGEST_SIZE], tweak[SHA256_DIGEST_SIZE];
+		struct sha256_ctx ctx;
+		secp256k1_xonly_pubkey_from_pubkey(secp256k1_context_static, &internal, NULL, pubkey);
+		secp256k1_xonly_pubkey_serialize(secp256k1_context_static, key, &internal);
+		sha256(tag, (const uint8 *) "TapTweak", strlen("TapTweak"));
+		sha256_begin(&ctx);
+		sha256_update(&ctx, tag, sizeof tag);
+		sha256_update(&ctx, tag, sizeof tag);
+		sha256_update(&ctx, key, XONLY_PUBKEY_SIZE);
+		sha256_end(&ctx, tweak);
+		if (_unlikely(!secp256k1_xonly_pubkey_tweak_add(secp256k1_context_static, &tweaked, &internal, tweak)))
+			return NULL;
+		secp256k1_xonly_pubkey_from_pubkey(secp256k1_context_static, &output, NULL, &tweaked);
+		script[0] = OP_1, script[1] = XONLY_PUBKEY_SIZE;
+		secp256k1_xonly_pubkey_serialize(secp256k1_context_static, &script[2], &output);
+		n_script = 2 + XONLY_PUBKEY_SIZE;
+	}
+	else {
+		secp256k1_ec_pubkey_serialize(secp256k1_context_static, key, &n_key, pubkey, SECP256K1_EC_COMPRESSED);
+		uint8 witness_script[2 + RIPEMD160_DIGEST_SIZE];
+		witness_script[0] = OP_0, witness_script[1] = RIPEMD160_DIGEST_SIZE;
+		hash160(&witness_script[2], key, n_key);
+		if (type == ADDRESS_TYPE_P2WPKH) {
+			memcpy(script, witness_script, sizeof witness_script);
+			n_script = sizeof witness_script;
+		}
+		else if (type == ADDRESS_TYPE_P2SH) { // P2SH-P2WPKH: the redeem script is the P2WPKH scriptPubKey
+			script[0] = OP_HASH160, script[1] = RIPEMD160_DIGEST_SIZE;
+			hash160(&script[2], witness_script, sizeof witness_script);
+			script[22] = OP_EQUAL;
+			n_script = P2SH_SCRIPT_SIZE;
+		}
+		else {
+			script[0] = OP_DUP, script[1] = OP_HASH160, script[2] = RIPEMD160_DIGEST_SIZE;
+			memcpy(&script[3], &witness_script[2], RIPEMD160_DIGEST_SIZE);
+			script[23] = OP_EQUALVERIFY, script[24] = OP_CHECKSIG;
+			n_script = P2PKH_SCRIPT_SIZE;
+		}
+	}
+	return script_address(script, n_script, network);
+}
+
+/*
+ * Returns the addresses at indices from through from + count - 1 under the given path. The result is materialized, since a
+ * value-per-call set-returning function would need fn_extra for its own state.
+ */
+PG_FUNCTION_INFO_V1(pg_derive_addresses);
+Datum
+pg_derive_addresses(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	if (_unlikely(!rsinfo || !IsA(rsinfo, ReturnSetInfo) || !(rsinfo->allowedModes & SFRM_Materialize)))
+		ereport(ERROR, errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("set-valued function called in context that cannot accept a set"));
+	Oid rettype;
+	if (_unlikely(get_call_result_type(fcinfo, &rettype, NULL) != TYPEFUNC_SCALAR))
+		elog(ERROR, "return type must be a scalar type");
+
+	int32 from = PG_GETARG_INT32(2), count = PG_GETARG_INT32(3);
+	if (_unlikely(from < 0 || count < 0 || (int64) from + count > (int64) HARDENED_INDEX))
+		ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				errmsg("indices from %d through %d are not all non-hardened", from, (int32) ((int64) from + count - 1)),
+				errhint("from and count must not be negative, and the indices must be below 2147483648."));
+	enum address_type type = address_type_from_oid(PG_GETARG_OID(4), &get_derivation_cache(fcinfo)->type);
+	if (_unlikely(type != ADDRESS_TYPE_P2PKH && type != ADDRESS_TYPE_P2SH && type != ADDRESS_TYPE_P2WPKH &&
+			type != ADDRESS_TYPE_P2TR))
+		ereport(ERROR, errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("addresses of this type cannot be derived from a public key"),
+				errhint("type must be one of p2pkh, p2sh (for P2SH-P2WPKH), p2wpkh, or p2tr"));
+	const struct derivation_cache *cache = derivation_node(fcinfo, PG_GETARG_VARLENA_PP(0), PG_GETARG_TEXT_PP(1));
+
+	MemoryContext oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	TupleDesc tupdesc = CreateTemplateTupleDesc(1);
+	TupleDescInitEntry(tupdesc, 1, "derive_addresses", rettype, -1, 0);
+	Tuplestorestate *tupstore = tuplestore_begin_heap(rsinfo->allowedModes & SFRM_Materialize_Random, false, work_mem);
+	MemoryContextSwitchTo(oldcontext);
+
+	for (uint32 index = (uint32) from; index < (uint32) from + (uint32) count; ++index) {
+		CHECK_FOR_INTERRUPTS();
+		secp256k1_pubkey pubkey;
+		if (_unlikely(!derive_child(&pubkey, NULL, &cache->node, index)))
+			continue;
+		bitcoin_address *address = pubkey_address(&pubkey, type, cache->network);
+		if (_unlikely(!address))
+			continue;
+		Datum value = PointerGetDatum(address);
+		bool isnull = false;
+		tuplestore_putvalues(tupstore, tupdesc, &value, &isnull);
+		pfree(address);
+	}
+
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	return (Datum) 0;
+}
@@ -0,0 +1,8 @@
+#include <postgres.h>
+
+#pragma GCC visibility push(hidden)
+
+// runs the self-test of libsecp256k1, whose static context the derivation functions use; called at module load
+void bip32_init(void);
+
+#pragma GCC visibility pop
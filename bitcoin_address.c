@@ -1,130 +1,73 @@
 #include <postgres.h>
 #include <fmgr.h>
 #include <funcapi.h>
+#include <math.h>
+#include <access/stratnum.h>
+#include <catalog/pg_am.h>
+#include <catalog/pg_enum.h>
+#include <catalog/pg_proc.h>
+#include <catalog/pg_statistic.h>
+#include <catalog/pg_type.h>
+#include <commands/vacuum.h>
+#include <common/hashfn.h>
+#include <lib/hyperloglog.h>
+#include <libpq/pqformat.h>
+#include <nodes/makefuncs.h>
+#include <nodes/nodeFuncs.h>
+#include <nodes/pathnodes.h>
+#include <nodes/supportnodes.h>
+#include <port/pg_bswap.h>
 #if HAVE_VARATT_H
 # include <varatt.h>
 #endif
+#include <utils/array.h>
 #include <utils/builtins.h>
+#include <utils/lsyscache.h>
+#include <utils/selfuncs.h>
+#include <utils/sortsupport.h>
+#include <utils/syscache.h>
 
 #include <base58check.h>
 
+#include "base58check21.h"
+#include "base58check_scratch.h"
 #include "bech32.h"
+#include "bech32_batch.h"
+#include "bitcoin_address.h"
+#include "conversion_cache.h"
+#include "sha256.h"
+#include "soft_error.h"
 
 #define _likely(...) __builtin_expect(!!(__VA_ARGS__), 1)
 #define _unlikely(...) __builtin_expect(!!(__VA_ARGS__), 0)
 
+// the shortest program that a legacy address may have after its version byte, whether it is parsed, constructed, or received
+#define LEGACY_PROGRAM_MIN_SIZE 1
 
-typedef struct varlena bitcoin_address;
-
-struct bitcoin_address_fields {
-	bool blech;
-	uint8 version;
-	int well_known_hrp_idx;
-	const char *hrp;
-	size_t n_hrp;
-	const uint8 *program;
-	size_t n_program;
-};
 
 /*
- * In memory and on disk, a bitcoin_address consists of an initial HRP length byte, followed by that many bytes of HRP, followed by
- * the 1-byte witness version, followed by the witness program. If the initial byte is 0xFF, it signifies a legacy address, in
- * which case the bytes that follow are exactly the bytes to be encoded in Base58Check. If the initial byte is between 84 and 0x7F,
- * it signifies a Blech32-encoded address, and the initial byte minus 83 gives the length of the HRP, except if the initial byte is
- * 0x7F, in which case the next two bytes give the length of the HRP (in network byte order). As an optimization, if the initial
- * byte has a value between 0x80 and 0xFE, then bit 6 indicates whether the encoding uses Blech32, the lower 6 bits give an index
- * into the table of well-known HRPs below, and no explicit HRP is stored.
+ * Checks that the fields of a SegWit address are within the limits of its encoding, raising the same errors as encoding would.
  */
-static const char *const well_known_hrp[] = { // DO NOT RE-ORDER!
-	// see SLIP-0173: Registered human-readable parts for BIP-0173
-	"bc", // Bitcoin Mainnet
-	"tb", // Bitcoin Testnet
-	"bcrt", // Bitcoin Regtest
-	"ex", // Liquidv1 explicit
-	"lq", // Liquidv1
-	"tex", // Liquid Testnet explicit
-	"tlq", // Liquid Testnet
-};
-
-static ssize_t find_well_known_hrp(const char *hrp, size_t n_hrp) {
-	for (size_t i = 0; i < sizeof well_known_hrp / sizeof *well_known_hrp; ++i)
-		if (strncasecmp(hrp, well_known_hrp[i], n_hrp) == 0 && well_known_hrp[i][n_hrp] == '\0')
-			return (ssize_t) i;
-	return -1;
-}
-
-static const char * get_well_known_hrp(size_t idx) {
-	if (_unlikely(idx >= sizeof well_known_hrp / sizeof *well_known_hrp))
-		ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
-				errmsg("stored bitcoin_address uses unknown human-readable prefix"));
-	return well_known_hrp[idx];
-}
-
-static void unpack(struct bitcoin_address_fields *restrict f, const bitcoin_address *restrict arg) {
-	const uint8 *data = (const uint8 *) VARDATA_ANY(arg);
-	size_t n_data = VARSIZE_ANY_EXHDR(arg);
-	if (_unlikely(n_data < 1/*n_hrp*/ + 1/*version*/))
-corrupted:
-		ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
-				errmsg("stored bitcoin_address is corrupted"));
-	size_t n_hrp = *data++; --n_data;
-	if (n_hrp == 0xFF) { // legacy address
-		f->blech = false;
-		f->well_known_hrp_idx = 0;
-		f->hrp = NULL;
-		f->n_hrp = 0;
-	}
-	else if (n_hrp >= 0x80) { // well-known HRP
-		if (f->blech = (n_hrp -= 0x80) >= 0x40)
-			n_hrp -= 0x40;
-		f->well_known_hrp_idx = (int) n_hrp;
-		f->n_hrp = strlen(f->hrp = get_well_known_hrp(n_hrp));
-	}
-	else if (_unlikely(n_hrp == 0))
-		goto corrupted;
-	else {
-		if (f->blech = n_hrp > BECH32_HRP_MAX_SIZE) { // blinding address
-			if (n_hrp == 0x7F) { // HRP length stored in next 2 bytes
-				if (_unlikely(n_data < 2))
-					goto corrupted;
-				n_hrp = data[0] << 8 | data[1];
-				data += 2, n_data -= 2;
-			}
-			else
-				n_hrp -= BECH32_HRP_MAX_SIZE;
-		}
-		if (_unlikely(n_data < n_hrp + 1/*version*/))
-			goto corrupted;
-		f->well_known_hrp_idx = -1;
-		f->hrp = (const char *) data, f->n_hrp = n_hrp;
-		data += n_hrp, n_data -= n_hrp;
-	}
-	f->version = *data++, --n_data;
-	f->program = data, f->n_program = n_data;
-}
-
-static void pack(bitcoin_address *restrict out, const struct bitcoin_address_fields *restrict f) {
-	uint8 *data = (uint8 *) VARDATA(out);
-	if (!f->hrp) // legacy address
-		*data++ = 0xFF;
-	else if (f->well_known_hrp_idx >= 0)
-		*data++ = (uint8) (f->well_known_hrp_idx + 0x80 + (f->blech ? 0x40 : 0));
-	else {
-		if (!f->blech)
-			*data++ = (uint8) f->n_hrp;
-		else if (BECH32_HRP_MAX_SIZE + f->n_hrp < 0x7F)
-			*data++ = (uint8) (BECH32_HRP_MAX_SIZE + f->n_hrp);
-		else
-			*data++ = 0x7F, *data++ = (uint8) (f->n_hrp >> 8), *data++ = (uint8) f->n_hrp;
-		for (size_t i = 0; i < f->n_hrp; ++i)
-			*data++ = (uint8) (f->hrp[i] | (f->hrp[i] >= 'A' && f->hrp[i] <= 'Z' ? 0x20 : 0));
-	}
-	*data++ = (uint8) f->version;
-	if (f->program != data)
-		memcpy(data, f->program, f->n_program);
+static void
+check_segwit_fields(const struct bitcoin_address_fields *f)
+{
+	const struct bech32_params *const params = f->blech ? &blech32_params : &bech32_params;
+	if (_unlikely((*params->encoded_size)(f->n_hrp, 5/*version*/ + f->n_program * BITS_PER_BYTE, 0) > params->max_size))
+		bech32_check_encode_error(BECH32_TOO_LONG, params);
+	if (_unlikely(f->n_hrp < params->hrp_min_size))
+		bech32_check_encode_error(BECH32_HRP_TOO_SHORT, params);
+	if (_unlikely(f->n_hrp > params->hrp_max_size))
+		bech32_check_encode_error(BECH32_HRP_TOO_LONG, params);
+	if (_unlikely(f->version > WITNESS_MAX_VERSION))
+		bech32_check_encode_error(SEGWIT_VERSION_ILLEGAL, params);
+	if (_unlikely(f->n_program < params->program_min_size))
+		bech32_check_encode_error(SEGWIT_PROGRAM_TOO_SHORT, params);
+	if (_unlikely(f->n_program > params->program_max_size))
+		bech32_check_encode_error(SEGWIT_PROGRAM_TOO_LONG, params);
+	if (_unlikely(f->version == 0 && f->n_program != params->program_pkh_size && f->n_program != params->program_sh_size))
+		bech32_check_encode_error(SEGWIT_PROGRAM_ILLEGAL_SIZE, params);
 }
 
-
 PG_FUNCTION_INFO_V1(pg_bitcoin_address);
 Datum
 pg_bitcoin_address(PG_FUNCTION_ARGS)
@@ -145,22 +88,9 @@ pg_bitcoin_address(PG_FUNCTION_ARGS)
 			const text *arg = PG_GETARG_TEXT_PP(0);
 			f.hrp = VARDATA_ANY(arg), f.n_hrp = VARSIZE_ANY_EXHDR(arg);
 		}
-		const struct bech32_params *const params = f.blech ? &blech32_params : &bech32_params;
-		if (_unlikely((*params->encoded_size)(f.n_hrp, 5/*version*/ + f.n_program * BITS_PER_BYTE, 0) > params->max_size))
-			bech32_check_encode_error(BECH32_TOO_LONG, params);
-		if (_unlikely(f.n_hrp < params->hrp_min_size))
-			bech32_check_encode_error(BECH32_HRP_TOO_SHORT, params);
-		if (_unlikely(f.n_hrp > params->hrp_max_size))
-			bech32_check_encode_error(BECH32_HRP_TOO_LONG, params);
 		if (_unlikely(version > WITNESS_MAX_VERSION))
-			bech32_check_encode_error(SEGWIT_VERSION_ILLEGAL, params);
-		if (_unlikely(f.n_program < params->program_min_size))
-			bech32_check_encode_error(SEGWIT_PROGRAM_TOO_SHORT, params);
-		if (_unlikely(f.n_program > params->program_max_size))
-			bech32_check_encode_error(SEGWIT_PROGRAM_TOO_LONG, params);
-		if (_unlikely(version == 0 && f.n_program != params->program_pkh_size && f.n_program != params->program_sh_size))
-			bech32_check_encode_error(SEGWIT_PROGRAM_ILLEGAL_SIZE, params);
-
+			f.version = UINT8_MAX; // rejected below
+		check_segwit_fields(&f);
 		f.well_known_hrp_idx = (int) find_well_known_hrp(f.hrp, f.n_hrp);
 	}
 	else { // legacy address
@@ -170,11 +100,13 @@ pg_bitcoin_address(PG_FUNCTION_ARGS)
 			ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 					errmsg("version is illegal"),
 					errhint("legacy address version must be between 0 and 255"));
+		if (_unlikely(f.n_program < LEGACY_PROGRAM_MIN_SIZE))
+			ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					errmsg("program is too short"),
+					errhint("legacy address program must not be empty"));
 	}
 
-	size_t n_out = VARHDRSZ + 1/*initial byte*/ +
-			(f.well_known_hrp_idx < 0 ? (f.blech && BECH32_HRP_MAX_SIZE + f.n_hrp >= 0x7F ? 2 : 0) + f.n_hrp : 0) +
-			1/*version*/ + f.n_program;
+	size_t n_out = packed_size(&f);
 	bitcoin_address *out = palloc(n_out);
 	pack(out, &f);
 
@@ -183,39 +115,123 @@ pg_bitcoin_address(PG_FUNCTION_ARGS)
 }
 
 
-PG_FUNCTION_INFO_V1(pg_bitcoin_address_input);
-Datum
-pg_bitcoin_address_input(PG_FUNCTION_ARGS)
+/*
+ * Character classes used to classify a textual address in a single pass before any decoding is attempted. A string containing
+ * any character outside of CHAR_HRP cannot be an address in any encoding.
+ */
+enum {
+	CHAR_HRP = 1 << 0, // US-ASCII character codes 33 through 126
+	CHAR_BECH32 = 1 << 1, // Bech32 data character (either case)
+	CHAR_BASE58 = 1 << 2, // Base58 alphabet
+	CHAR_UPPER = 1 << 3,
+	CHAR_LOWER = 1 << 4,
+};
+
+static const uint8 char_classes[256] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x03, 0x05, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x0F, 0x0D, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x09, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x09,
+	0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x17, 0x15, 0x17, 0x17, 0x17, 0x17, 0x17, 0x17, 0x15, 0x17, 0x17, 0x13, 0x17, 0x17, 0x15,
+	0x17, 0x17, 0x17, 0x17, 0x17, 0x17, 0x17, 0x17, 0x17, 0x17, 0x17, 0x01, 0x01, 0x01, 0x01, 0x00,
+};
+
+// well-known HRPs whose addresses are usually Blech32-encoded
+static const uint32 well_known_hrp_blech_preferred = 1 << 4/*lq*/ | 1 << 6/*tlq*/;
+
+/*
+ * Classifies a textual address. Returns false if it cannot be an address in any encoding. Otherwise, sets *separator to the
+ * position of the SegWit separator if it may be a SegWit address (or to NULL if not) and sets *maybe_legacy to whether it may be a
+ * legacy address.
+ */
+static bool
+classify_address_text(const char *in, size_t n_in, const char **separator, bool *maybe_legacy)
 {
-	const char *in = PG_GETARG_CSTRING(0);
-	size_t n_in = strlen(in), n_out = 0;
+	uint8 classes_all = (uint8) -1, classes_any = 0;
+	const char *last_non_bech32 = NULL;
+	for (size_t i = 0; i < n_in; ++i) {
+		uint8 classes = char_classes[(uint8) in[i]];
+		classes_all &= classes, classes_any |= classes;
+		if (!(classes & CHAR_BECH32))
+			last_non_bech32 = &in[i];
+	}
+	if (_unlikely(n_in == 0 || !(classes_all & CHAR_HRP)))
+		return false;
+	// A SegWit address must contain a separator that is followed only by Bech32 data characters and must not use mixed case.
+	bool maybe_segwit = last_non_bech32 && *last_non_bech32 == '1' && last_non_bech32 > in &&
+			(classes_any & (CHAR_UPPER | CHAR_LOWER)) != (CHAR_UPPER | CHAR_LOWER);
+	*separator = maybe_segwit ? last_non_bech32 : NULL;
+	*maybe_legacy = classes_all & CHAR_BASE58;
+	return true;
+}
+
+/*
+ * Returns whether a SegWit address of n_in characters whose HRP has n_hrp characters should be decoded with Blech32 before Bech32.
+ * A version 0 program must have the P2WPKH or P2WSH size of its encoding, so when the length of a version 0 address admits such a
+ * program in only one encoding, that encoding goes first. Otherwise Blech32 goes first for the HRPs usually encoded with it.
+ */
+static inline bool __attribute__ ((__pure__))
+blech_first(const char *in, size_t n_in, size_t n_hrp, int well_known_hrp_idx)
+{
+	if (n_in > n_hrp + 1/*separator*/ && (in[n_hrp + 1] | 0x20) == 'q'/*version 0*/) {
+		const struct bech32_params *const paramses[] = { &bech32_params, &blech32_params };
+		bool fits[sizeof paramses / sizeof *paramses];
+		for (size_t i = 0; i < sizeof paramses / sizeof *paramses; ++i) {
+			size_t n_data = n_in - n_hrp - 1/*separator*/ - 1/*version*/;
+			size_t n_program = n_data > paramses[i]->checksum_size ?
+					(n_data - paramses[i]->checksum_size) * 5 / BITS_PER_BYTE : 0;
+			fits[i] = n_program == paramses[i]->program_pkh_size || n_program == paramses[i]->program_sh_size;
+		}
+		if (fits[0] != fits[1])
+			return fits[1];
+	}
+	return (size_t) well_known_hrp_idx < N_BUILTIN_HRPS && well_known_hrp_blech_preferred >> well_known_hrp_idx & 1;
+}
+
+/*
+ * Sets f->blech and f->n_program for decoding a SegWit address of n_in characters whose HRP is given by f with the given encoding,
+ * and returns whether the sizes of the address, its HRP, and its program are all permitted by that encoding.
+ */
+static inline bool
+segwit_sizes_plausible(struct bitcoin_address_fields *f, size_t n_in, const struct bech32_params *params)
+{
+	f->blech = params == &blech32_params;
+	f->n_program = (n_in - f->n_hrp - 1/*separator*/ - 1/*version*/ - params->checksum_size) * 5 / BITS_PER_BYTE;
+	return !(n_in < params->address_min_size || n_in > params->max_size ||
+			f->n_hrp < params->hrp_min_size || f->n_hrp > params->hrp_max_size ||
+			n_in < params->address_min_size - params->hrp_min_size + f->n_hrp ||
+			f->n_program < params->program_min_size || f->n_program > params->program_max_size);
+}
+
+static bitcoin_address *
+parse_bitcoin_address(const char *in, size_t n_in, struct Node *escontext)
+{
+	size_t n_out = 0;
 	bitcoin_address *out = NULL;
 
-	const char *sep = memrchr(in, '1', n_in);
-	if (!sep)
+	const char *separator;
+	bool maybe_legacy;
+	if (_unlikely(!classify_address_text(in, n_in, &separator, &maybe_legacy)))
+		goto invalid;
+	if (!separator)
 		goto not_segwit;
 
 	struct bitcoin_address_fields f;
-	f.well_known_hrp_idx = (int) find_well_known_hrp(f.hrp = in, f.n_hrp = sep - in);
+	f.well_known_hrp_idx = (int) find_well_known_hrp(f.hrp = in, f.n_hrp = separator - in);
 
-	static const struct bech32_params *const paramses[] = { &bech32_params, &blech32_params };
+	const struct bech32_params *paramses[] = { &bech32_params, &blech32_params };
+	if (blech_first(in, n_in, f.n_hrp, f.well_known_hrp_idx))
+		paramses[0] = &blech32_params, paramses[1] = &bech32_params;
 	for (size_t params_idx = 0; params_idx < sizeof paramses / sizeof *paramses; ++params_idx) {
 		const struct bech32_params *const params = paramses[params_idx];
 
-		f.blech = params == &blech32_params;
-		f.n_program = (n_in - f.n_hrp - 1/*separator*/ - 1/*version*/ - params->checksum_size) * 5 / BITS_PER_BYTE;
-		if (n_in < params->address_min_size || n_in > params->max_size ||
-				f.n_hrp < params->hrp_min_size || f.n_hrp > params->hrp_max_size ||
-				n_in < params->address_min_size - params->hrp_min_size + f.n_hrp ||
-				f.n_program < params->program_min_size || f.n_program > params->program_max_size)
+		if (!segwit_sizes_plausible(&f, n_in, params))
 			continue;
 
-		size_t program_offset = 1/*initial byte*/ +
-				(f.well_known_hrp_idx < 0 ? (f.blech && BECH32_HRP_MAX_SIZE + f.n_hrp >= 0x7F ? 2 : 0) + f.n_hrp : 0) +
-				1/*version*/;
-		if (out) pfree(out);
-		out = palloc(n_out = VARHDRSZ + program_offset + f.n_program);
-		uint8 *program = (uint8 *) (VARDATA(out) + program_offset);
+		// the program is decoded onto the stack so that failed attempts allocate nothing
+		uint8 program[Max(WITNESS_PROGRAM_MAX_SIZE, BLINDING_PROGRAM_MAX_SIZE)];
 		f.program = program;
 
 		size_t n_hrp_actual;
@@ -234,8 +250,8 @@ pg_bitcoin_address_input(PG_FUNCTION_ARGS)
 				case BECH32_CHECKSUM_FAILURE:
 					continue;
 				case SEGWIT_PROGRAM_ILLEGAL_SIZE:
-					bech32_check_decode_error(n_program_actual, in, n_in);
-					// fall through
+					bech32_check_decode_error(n_program_actual, in, n_in, escontext);
+					return NULL;
 				case BECH32_TOO_SHORT:
 				case BECH32_TOO_LONG:
 				case BECH32_NO_SEPARATOR:
@@ -248,39 +264,56 @@ pg_bitcoin_address_input(PG_FUNCTION_ARGS)
 			}
 		else if (_likely((size_t) n_program_actual == f.n_program && n_hrp_actual == f.n_hrp)) {
 			f.version = (uint8) version;
-			pack(out, &f);
+			pack(out = palloc(n_out = packed_size(&f)), &f);
 			goto success;
 		}
 		ereport(ERROR, errcode(ERRCODE_INTERNAL_ERROR),
 				errmsg("internal error %d", (int) n_program_actual),
-				errdetail_internal("%s", in));
+				errdetail_internal("%.*s", (int) n_in, in));
 	}
 
 not_segwit:
-	if (out) pfree(out), out = NULL, n_out = 0;
-	if (_unlikely(base58check_decode((unsigned char **) &out, &n_out, in, n_in, VARHDRSZ + 1) < 0 || n_out <= VARHDRSZ + 1))
-		ereport(ERROR, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+	if (maybe_legacy) {
+		uint8 payload[BASE58CHECK21_PAYLOAD_SIZE];
+		int ret = base58check21_decode(payload, in, n_in);
+		if (_likely(ret > 0)) {
+			out = palloc(n_out = VARHDRSZ + 1 + sizeof payload);
+			memcpy(VARDATA(out) + 1, payload, sizeof payload);
+			goto legacy;
+		}
+		if (ret < 0)
+			goto invalid;
+	}
+	if (_unlikely(!maybe_legacy ||
+			scratch_base58check_decode((unsigned char **) &out, &n_out, in, n_in, VARHDRSZ + 1) < 0 ||
+			n_out < VARHDRSZ + 1 + 1/*version*/ + LEGACY_PROGRAM_MIN_SIZE))
+invalid:
+		ereturn(escontext, NULL, errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
 				errmsg("not a valid Bitcoin address"),
-				errdetail_internal("%s", in));
+				errdetail_internal("%.*s", (int) n_in, in));
+legacy:
 	VARDATA(out)[0] = (uint8) 0xFF;
 
 success:
 	SET_VARSIZE(out, n_out);
-	PG_RETURN_POINTER(out);
+	return out;
 }
 
-PG_FUNCTION_INFO_V1(pg_bitcoin_address_output);
-Datum
-pg_bitcoin_address_output(PG_FUNCTION_ARGS)
+static char *
+format_bitcoin_address(const bitcoin_address *arg)
 {
 	struct bitcoin_address_fields f;
-	unpack(&f, (const bitcoin_address *) PG_GETARG_POINTER(0));
+	unpack(&f, arg);
 
 	char *out = NULL;
 	size_t n_out;
-	if (!f.hrp) { // legacy address
+	if (!f.hrp && f.n_program + 1 == BASE58CHECK21_PAYLOAD_SIZE) { // legacy address of the usual size
+		out = palloc(BASE58CHECK21_MAX_SIZE + 1/*null terminator*/);
+		n_out = base58check21_encode(out, f.program - 1);
+	}
+	else if (!f.hrp) { // legacy address
 		n_out = 1/*null terminator*/;
-		if (_unlikely(base58check_encode(&out, &n_out, f.program - 1, f.n_program + 1, 0) < 0))
+		if (_unlikely(scratch_base58check_encode(&out, &n_out, f.program - 1, f.n_program + 1, 0) < 0))
 			ereport(ERROR, errcode(ERRCODE_INTERNAL_ERROR),
 					errmsg("internal error"));
 	}
@@ -293,9 +326,323 @@ pg_bitcoin_address_output(PG_FUNCTION_ARGS)
 			params);
 	}
 	out[n_out] = '\0';
+	return out;
+}
+
+
+static bool check_typmod(const bitcoin_address *value, int32 typmod, struct Node *escontext);
+
+// the input and receive functions are declared with one argument, but they are always called with the type OID and typmod too
+#define GETARG_IO_TYPMOD() (PG_NARGS() > 2 ? PG_GETARG_INT32(2) : -1)
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_input);
+Datum
+pg_bitcoin_address_input(PG_FUNCTION_ARGS)
+{
+	const char *in = PG_GETARG_CSTRING(0);
+	size_t n_in = strlen(in);
+
+	bitcoin_address *out = NULL;
+	struct conversion_cache *cache = conversion_cache_get(fcinfo->flinfo, CONVERSION_CACHE_INPUT);
+	if (cache) {
+		size_t n_out;
+		const void *cached = conversion_cache_lookup(cache, in, n_in, &n_out);
+		if (cached)
+			out = memcpy(palloc(n_out), cached, n_out);
+	}
+	if (!out) {
+		out = parse_bitcoin_address(in, n_in, fcinfo->context);
+		if (cache && out)
+			conversion_cache_store(cache, in, n_in, out, VARSIZE(out));
+	}
+	if (out && _unlikely(!check_typmod(out, GETARG_IO_TYPMOD(), fcinfo->context)))
+		out = NULL;
+	PG_RETURN_POINTER(out);
+}
+
+PG_FUNCTION_INFO_V1(pg_try_bitcoin_address);
+Datum
+pg_try_bitcoin_address(PG_FUNCTION_ARGS)
+{
+	const text *in = PG_GETARG_TEXT_PP(0);
+
+	ErrorSaveContext escontext = { T_ErrorSaveContext };
+	bitcoin_address *out = parse_bitcoin_address(VARDATA_ANY(in), VARSIZE_ANY_EXHDR(in), (struct Node *) &escontext);
+	if (SOFT_ERROR_OCCURRED(&escontext))
+		PG_RETURN_NULL();
+	PG_RETURN_POINTER(out);
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_output);
+Datum
+pg_bitcoin_address_output(PG_FUNCTION_ARGS)
+{
+	const bitcoin_address *arg = (const bitcoin_address *) PG_GETARG_POINTER(0);
+
+	// the cache is keyed on the packed representation, and the caller receives its own copy of the cached string
+	struct conversion_cache *cache = conversion_cache_get(fcinfo->flinfo, CONVERSION_CACHE_OUTPUT);
+	if (cache) {
+		size_t n_out;
+		const char *cached = conversion_cache_lookup(cache, VARDATA_ANY(arg), VARSIZE_ANY_EXHDR(arg), &n_out);
+		if (cached)
+			PG_RETURN_CSTRING(memcpy(palloc(n_out), cached, n_out));
+	}
+	char *out = format_bitcoin_address(arg);
+	if (cache)
+		conversion_cache_store(cache, VARDATA_ANY(arg), VARSIZE_ANY_EXHDR(arg), out, strlen(out) + 1/*null terminator*/);
 	PG_RETURN_CSTRING(out);
 }
 
+
+/*
+ * The binary wire format of bitcoin_address is a format version byte (currently 1) followed by the packed representation described
+ * in bitcoin_address.h, except that registry indices, which are meaningful only in the database that assigned them, are never
+ * sent: values with registered HRPs are sent with their HRPs inline. Received values are validated structurally, without any
+ * checksum computation, and are re-packed through the local registry so that they are stored in canonical form.
+ */
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_receive);
+Datum
+pg_bitcoin_address_receive(PG_FUNCTION_ARGS)
+{
+	StringInfo buf = (StringInfo) PG_GETARG_POINTER(0);
+
+	int format = pq_getmsgbyte(buf);
+	if (_unlikely(format != BITCOIN_ADDRESS_BINARY_FORMAT))
+		ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				errmsg("unsupported bitcoin_address binary format version %d", format));
+	size_t n_data = (size_t) (buf->len - buf->cursor);
+	const uint8 *data = (const uint8 *) pq_getmsgbytes(buf, (int) n_data);
+	if (_unlikely(uses_registered_hrp(data, n_data)))
+		ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				errmsg("binary bitcoin_address uses unknown human-readable prefix"),
+				errdetail("Registered human-readable prefixes must be sent inline."));
+
+	struct bitcoin_address_fields f;
+	const char *problem = unpack_data(&f, data, n_data);
+	if (_unlikely(problem))
+		ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				errmsg("binary bitcoin_address %s", problem));
+	if (f.hrp) {
+		for (size_t i = 0; i < f.n_hrp; ++i)
+			if (_unlikely(!(char_classes[(uint8) f.hrp[i]] & CHAR_HRP)))
+				ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+						errmsg("binary bitcoin_address has an illegal character in its human-readable prefix"));
+		check_segwit_fields(&f);
+		if (f.well_known_hrp_idx < 0)
+			f.well_known_hrp_idx = (int) find_well_known_hrp(f.hrp, f.n_hrp);
+	}
+	else if (_unlikely(f.n_program < LEGACY_PROGRAM_MIN_SIZE))
+		ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				errmsg("binary bitcoin_address has a legacy program that is too short"));
+
+	size_t n_out = packed_size(&f);
+	bitcoin_address *out = palloc(n_out);
+	pack(out, &f);
+
+	SET_VARSIZE(out, n_out);
+	check_typmod(out, GETARG_IO_TYPMOD(), NULL);
+	PG_RETURN_POINTER(out);
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_send);
+Datum
+pg_bitcoin_address_send(PG_FUNCTION_ARGS)
+{
+	const bitcoin_address *arg = (const bitcoin_address *) PG_GETARG_POINTER(0);
+
+	if (_unlikely(uses_registered_hrp((const uint8 *) VARDATA_ANY(arg), VARSIZE_ANY_EXHDR(arg)))) {
+		struct bitcoin_address_fields f;
+		unpack(&f, arg);
+		f.well_known_hrp_idx = -1;
+		bitcoin_address *inline_arg = palloc(packed_size(&f));
+		pack(inline_arg, &f);
+		SET_VARSIZE(inline_arg, packed_size(&f));
+		arg = inline_arg;
+	}
+
+	StringInfoData buf;
+	pq_begintypsend(&buf);
+	pq_sendbyte(&buf, BITCOIN_ADDRESS_BINARY_FORMAT);
+	pq_sendbytes(&buf, VARDATA_ANY(arg), (int) VARSIZE_ANY_EXHDR(arg));
+	PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
+}
+
+/*
+ * The array conversion functions convert every element into a scratch memory context, which is discarded after the result array
+ * has been constructed in a single allocation in the caller's memory context.
+ */
+static MemoryContext
+create_conversion_context(void)
+{
+	return AllocSetContextCreate(CurrentMemoryContext, "bitcoin_address array conversion", ALLOCSET_DEFAULT_SIZES);
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_from_text_array);
+Datum
+pg_bitcoin_address_from_text_array(PG_FUNCTION_ARGS)
+{
+	ArrayType *arr = PG_GETARG_ARRAYTYPE_P(0);
+	Oid elemtype = get_element_type(get_fn_expr_rettype(fcinfo->flinfo));
+	if (_unlikely(!OidIsValid(elemtype)))
+		ereport(ERROR, errcode(ERRCODE_INTERNAL_ERROR),
+				errmsg("could not determine result element type"));
+
+	Datum *elems;
+	bool *nulls;
+	int n_elems;
+	deconstruct_array(arr, TEXTOID, -1, false, TYPALIGN_INT, &elems, &nulls, &n_elems);
+
+	/*
+	 * Elements that may be SegWit addresses and elements that can only be legacy addresses are first decoded together so that their
+	 * checksums are verified in batches. A SegWit element is decoded in the batch only with the encoding that the parser would try
+	 * first, so an element that the batch decoder accepts is one that the parser would accept with the same result. Any that the
+	 * batch decoders do not accept, and all other elements, are then parsed one at a time, which also reports errors.
+	 */
+	MemoryContext scratch = create_conversion_context(), oldcontext = MemoryContextSwitchTo(scratch);
+	const char **legacy_in = palloc(Max(n_elems, 1) * sizeof *legacy_in);
+	size_t *legacy_n_in = palloc(Max(n_elems, 1) * sizeof *legacy_n_in), n_legacy = 0;
+	int *legacy_idx = palloc(Max(n_elems, 1) * sizeof *legacy_idx);
+	struct segwit_batch_decode_entry *segwit_entries = palloc(Max(n_elems, 1) * sizeof *segwit_entries);
+	int *segwit_idx = palloc(Max(n_elems, 1) * sizeof *segwit_idx);
+	size_t n_segwit = 0;
+	bool *decoded = palloc0(Max(n_elems, 1) * sizeof *decoded);
+	for (int i = 0; i < n_elems; ++i)
+		if (!nulls[i]) {
+			const text *in = (const text *) DatumGetPointer(elems[i]);
+			const char *separator;
+			bool maybe_legacy;
+			if (!classify_address_text(VARDATA_ANY(in), VARSIZE_ANY_EXHDR(in), &separator, &maybe_legacy))
+				continue;
+			if (separator) {
+				struct bitcoin_address_fields f;
+				f.n_hrp = (size_t) (separator - VARDATA_ANY(in));
+				int idx = (int) find_well_known_hrp(VARDATA_ANY(in), f.n_hrp);
+				if (!segwit_sizes_plausible(&f, VARSIZE_ANY_EXHDR(in),
+						blech_first(VARDATA_ANY(in), VARSIZE_ANY_EXHDR(in), f.n_hrp, idx) ? &blech32_params : &bech32_params))
+					continue;
+				segwit_entries[n_segwit] = (struct segwit_batch_decode_entry) {
+					.in = VARDATA_ANY(in),
+					.n_in = VARSIZE_ANY_EXHDR(in),
+					.n_hrp = f.n_hrp,
+					.blech = f.blech,
+					.program = palloc(f.n_program),
+				};
+				segwit_idx[n_segwit++] = i;
+			}
+			else if (maybe_legacy)
+				legacy_in[n_legacy] = VARDATA_ANY(in), legacy_n_in[n_legacy] = VARSIZE_ANY_EXHDR(in), legacy_idx[n_legacy++] = i;
+		}
+
+	segwit_batch_decode(segwit_entries, n_segwit);
+	for (size_t j = 0; j < n_segwit; ++j) {
+		const struct segwit_batch_decode_entry *entry = &segwit_entries[j];
+		if (!entry->valid)
+			continue;
+		struct bitcoin_address_fields f = {
+			.blech = entry->blech,
+			.version = entry->version,
+			.well_known_hrp_idx = (int) find_well_known_hrp(entry->in, entry->n_hrp),
+			.hrp = entry->in,
+			.n_hrp = entry->n_hrp,
+			.program = entry->program,
+			.n_program = segwit_batch_program_size(entry),
+		};
+		size_t n_out = packed_size(&f);
+		bitcoin_address *out = palloc(n_out);
+		pack(out, &f);
+		SET_VARSIZE(out, n_out);
+		elems[segwit_idx[j]] = PointerGetDatum(out), decoded[segwit_idx[j]] = true;
+	}
+
+	uint8 (*payloads)[BASE58CHECK21_PAYLOAD_SIZE] = palloc(Max(n_legacy, 1) * sizeof *payloads);
+	int *rets = palloc(Max(n_legacy, 1) * sizeof *rets);
+	base58check21_decode_batch(payloads, rets, legacy_in, legacy_n_in, n_legacy);
+	for (size_t j = 0; j < n_legacy; ++j)
+		if (rets[j] > 0) {
+			size_t n_out = VARHDRSZ + 1 + sizeof *payloads;
+			bitcoin_address *out = palloc(n_out);
+			VARDATA(out)[0] = (uint8) 0xFF;
+			memcpy(VARDATA(out) + 1, payloads[j], sizeof *payloads);
+			SET_VARSIZE(out, n_out);
+			elems[legacy_idx[j]] = PointerGetDatum(out), decoded[legacy_idx[j]] = true;
+		}
+
+	for (int i = 0; i < n_elems; ++i)
+		if (!nulls[i] && !decoded[i]) {
+			const text *in = (const text *) DatumGetPointer(elems[i]);
+			elems[i] = PointerGetDatum(parse_bitcoin_address(VARDATA_ANY(in), VARSIZE_ANY_EXHDR(in), NULL));
+		}
+	MemoryContextSwitchTo(oldcontext);
+
+	ArrayType *out = construct_md_array(elems, nulls, ARR_NDIM(arr), ARR_DIMS(arr), ARR_LBOUND(arr),
+			elemtype, -1, false, TYPALIGN_INT);
+	MemoryContextDelete(scratch);
+	PG_RETURN_ARRAYTYPE_P(out);
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_to_text_array);
+Datum
+pg_bitcoin_address_to_text_array(PG_FUNCTION_ARGS)
+{
+	ArrayType *arr = PG_GETARG_ARRAYTYPE_P(0);
+
+	Datum *elems;
+	bool *nulls;
+	int n_elems;
+	deconstruct_array(arr, ARR_ELEMTYPE(arr), -1, false, TYPALIGN_INT, &elems, &nulls, &n_elems);
+
+	/*
+	 * SegWit addresses and legacy addresses of the usual size are collected and then encoded together by the batch encoders, which
+	 * compute their checksums several at a time. Other legacy addresses are formatted one at a time. The unpacked fields point into
+	 * the deconstructed array, which remains valid until the batches have been encoded.
+	 */
+	MemoryContext scratch = create_conversion_context(), oldcontext = MemoryContextSwitchTo(scratch);
+	struct segwit_batch_entry *entries = palloc(Max(n_elems, 1) * sizeof *entries);
+	const uint8 **legacy_in = palloc(Max(n_elems, 1) * sizeof *legacy_in);
+	int *legacy_idx = palloc(Max(n_elems, 1) * sizeof *legacy_idx);
+	size_t n_entries = 0, n_legacy = 0;
+	for (int i = 0; i < n_elems; ++i) {
+		if (nulls[i])
+			continue;
+		const bitcoin_address *addr = (const bitcoin_address *) DatumGetPointer(elems[i]);
+		struct bitcoin_address_fields f;
+		unpack(&f, addr);
+		if (!f.hrp && f.n_program + 1 == BASE58CHECK21_PAYLOAD_SIZE) {
+			legacy_in[n_legacy] = f.program - 1, legacy_idx[n_legacy++] = i;
+			continue;
+		}
+		if (!f.hrp) {
+			elems[i] = PointerGetDatum(cstring_to_text(format_bitcoin_address(addr)));
+			continue;
+		}
+		struct segwit_batch_entry *entry = &entries[n_entries];
+		*entry = (struct segwit_batch_entry) {
+			.hrp = f.hrp, .n_hrp = f.n_hrp,
+			.program = f.program, .n_program = f.n_program,
+			.version = f.version, .blech = f.blech,
+		};
+		size_t n_out = segwit_batch_encoded_size(entry);
+		text *t = palloc(VARHDRSZ + n_out);
+		++n_entries;
+		SET_VARSIZE(t, VARHDRSZ + n_out);
+		entry->out = VARDATA(t);
+		elems[i] = PointerGetDatum(t);
+	}
+	segwit_batch_encode(entries, n_entries);
+	char (*legacy_out)[BASE58CHECK21_MAX_SIZE] = palloc(Max(n_legacy, 1) * sizeof *legacy_out);
+	size_t *legacy_n_out = palloc(Max(n_legacy, 1) * sizeof *legacy_n_out);
+	base58check21_encode_batch(legacy_out, legacy_n_out, legacy_in, n_legacy);
+	for (size_t j = 0; j < n_legacy; ++j)
+		elems[legacy_idx[j]] = PointerGetDatum(cstring_to_text_with_len(legacy_out[j], (int) legacy_n_out[j]));
+	MemoryContextSwitchTo(oldcontext);
+
+	ArrayType *out = construct_md_array(elems, nulls, ARR_NDIM(arr), ARR_DIMS(arr), ARR_LBOUND(arr),
+			TEXTOID, -1, false, TYPALIGN_INT);
+	MemoryContextDelete(scratch);
+	PG_RETURN_ARRAYTYPE_P(out);
+}
+
+
 PG_FUNCTION_INFO_V1(pg_bitcoin_address_is_segwit);
 Datum __attribute__ ((__pure__))
 pg_bitcoin_address_is_segwit(PG_FUNCTION_ARGS)
@@ -357,3 +704,1054 @@ pg_bitcoin_address_program_size(PG_FUNCTION_ARGS)
 
 	PG_RETURN_UINT32((uint32) f.n_program);
 }
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_program_starts_with);
+Datum
+pg_bitcoin_address_program_starts_with(PG_FUNCTION_ARGS)
+{
+	struct bitcoin_address_fields f;
+	unpack(&f, PG_GETARG_VARLENA_PP(0));
+	const bytea *prefix = PG_GETARG_BYTEA_PP(1);
+	size_t n_prefix = VARSIZE_ANY_EXHDR(prefix);
+
+	PG_RETURN_BOOL(f.n_program >= n_prefix && memcmp(f.program, VARDATA_ANY(prefix), n_prefix) == 0);
+}
+
+
+/*
+ * BRIN minmax-multi indexes need a distance between two values to decide which values to merge into ranges. For the raw bytes of
+ * bitcoin_address and base58check values, the distance is the difference of the leading bytes, interpreted as base-256 fractions,
+ * which agrees with the byte-wise ordering of the values.
+ */
+#define BRIN_DISTANCE_BYTES 16
+
+PG_FUNCTION_INFO_V1(pg_brin_minmax_multi_distance_bytes);
+Datum
+pg_brin_minmax_multi_distance_bytes(PG_FUNCTION_ARGS)
+{
+	const struct varlena *a = PG_GETARG_VARLENA_PP(0), *b = PG_GETARG_VARLENA_PP(1);
+	const uint8 *data_a = (const uint8 *) VARDATA_ANY(a), *data_b = (const uint8 *) VARDATA_ANY(b);
+	size_t n_a = VARSIZE_ANY_EXHDR(a), n_b = VARSIZE_ANY_EXHDR(b);
+
+	double distance = 0.0, scale = 1.0;
+	for (size_t i = 0; i < BRIN_DISTANCE_BYTES; ++i, scale /= 256.0)
+		distance += (double) ((i < n_b ? data_b[i] : 0) - (i < n_a ? data_a[i] : 0)) * scale;
+	PG_RETURN_FLOAT8(fabs(distance));
+}
+
+
+/*
+ * The classification functions return values of SQL enum types whose labels must be declared in the same order as the C
+ * enumerators in bitcoin_address.h. The OIDs of the labels are looked up once per call site and cached in fn_extra.
+ */
+static const char *const address_type_labels[] = { // indexed by enum address_type
+	"unknown",
+	"p2pkh",
+	"p2sh",
+	"p2wpkh",
+	"p2wsh",
+	"p2tr",
+	"p2pkh_blinded",
+	"p2sh_blinded",
+	"p2wpkh_blinded",
+	"p2wsh_blinded",
+	"p2tr_blinded",
+};
+
+static const char *const address_network_labels[] = { // indexed by enum address_network
+	"unknown",
+	"mainnet",
+	"testnet",
+	"regtest",
+	"liquidv1",
+	"liquidtestnet",
+};
+
+// version bytes of legacy addresses; a blinded version of 0 means the network has no blinded legacy addresses
+static const struct {
+	enum address_network network;
+	uint8 pkh, sh, blinded;
+} legacy_versions[] = {
+	{ ADDRESS_NETWORK_MAINNET, 0, 5, 0 },
+	{ ADDRESS_NETWORK_TESTNET, 111, 196, 0 },
+	{ ADDRESS_NETWORK_LIQUIDV1, 57, 39, 12 },
+	{ ADDRESS_NETWORK_LIQUIDTESTNET, 36, 19, 23 },
+};
+
+// networks of the well-known HRPs, indexed by well_known_hrp_idx and blech
+static const enum address_network well_known_hrp_networks[][2] = {
+	{ ADDRESS_NETWORK_MAINNET, ADDRESS_NETWORK_UNKNOWN }, // bc
+	{ ADDRESS_NETWORK_TESTNET, ADDRESS_NETWORK_UNKNOWN }, // tb
+	{ ADDRESS_NETWORK_REGTEST, ADDRESS_NETWORK_UNKNOWN }, // bcrt
+	{ ADDRESS_NETWORK_LIQUIDV1, ADDRESS_NETWORK_UNKNOWN }, // ex
+	{ ADDRESS_NETWORK_UNKNOWN, ADDRESS_NETWORK_LIQUIDV1 }, // lq
+	{ ADDRESS_NETWORK_LIQUIDTESTNET, ADDRESS_NETWORK_UNKNOWN }, // tex
+	{ ADDRESS_NETWORK_UNKNOWN, ADDRESS_NETWORK_LIQUIDTESTNET }, // tlq
+};
+
+#define LEGACY_PROGRAM_SIZE 20
+#define LEGACY_BLINDED_PROGRAM_SIZE 54
+
+static enum address_network __attribute__ ((__pure__))
+classify_network(const struct bitcoin_address_fields *f)
+{
+	if (f->hrp)
+		return (size_t) f->well_known_hrp_idx < N_BUILTIN_HRPS ?
+				well_known_hrp_networks[f->well_known_hrp_idx][f->blech] : ADDRESS_NETWORK_UNKNOWN;
+	for (size_t i = 0; i < sizeof legacy_versions / sizeof *legacy_versions; ++i)
+		if (f->n_program == LEGACY_PROGRAM_SIZE) {
+			if (f->version == legacy_versions[i].pkh || f->version == legacy_versions[i].sh)
+				return legacy_versions[i].network;
+		}
+		else if (f->n_program == LEGACY_BLINDED_PROGRAM_SIZE) {
+			if (legacy_versions[i].blinded && f->version == legacy_versions[i].blinded)
+				return legacy_versions[i].network;
+		}
+	return ADDRESS_NETWORK_UNKNOWN;
+}
+
+static enum address_type __attribute__ ((__pure__))
+classify_address_type(const struct bitcoin_address_fields *f)
+{
+	if (f->hrp) {
+		const struct bech32_params *params = f->blech ? &blech32_params : &bech32_params;
+		if (f->version == 0 && f->n_program == params->program_pkh_size)
+			return f->blech ? ADDRESS_TYPE_P2WPKH_BLINDED : ADDRESS_TYPE_P2WPKH;
+		if (f->version == 0 && f->n_program == params->program_sh_size)
+			return f->blech ? ADDRESS_TYPE_P2WSH_BLINDED : ADDRESS_TYPE_P2WSH;
+		if (f->version == 1 && f->n_program == params->program_tr_size)
+			return f->blech ? ADDRESS_TYPE_P2TR_BLINDED : ADDRESS_TYPE_P2TR;
+		return ADDRESS_TYPE_UNKNOWN;
+	}
+	for (size_t i = 0; i < sizeof legacy_versions / sizeof *legacy_versions; ++i)
+		if (f->n_program == LEGACY_PROGRAM_SIZE) {
+			if (f->version == legacy_versions[i].pkh)
+				return ADDRESS_TYPE_P2PKH;
+			if (f->version == legacy_versions[i].sh)
+				return ADDRESS_TYPE_P2SH;
+		}
+		else if (f->n_program == LEGACY_BLINDED_PROGRAM_SIZE) {
+			// the first byte of the program is the version of the unblinded address
+			if (!legacy_versions[i].blinded || f->version != legacy_versions[i].blinded)
+				continue;
+			if (f->program[0] == legacy_versions[i].pkh)
+				return ADDRESS_TYPE_P2PKH_BLINDED;
+			if (f->program[0] == legacy_versions[i].sh)
+				return ADDRESS_TYPE_P2SH_BLINDED;
+		}
+	return ADDRESS_TYPE_UNKNOWN;
+}
+
+static Datum
+enum_label_datum(FunctionCallInfo fcinfo, const char *const labels[], size_t n_labels, size_t idx)
+{
+	Oid *label_oids = fcinfo->flinfo->fn_extra;
+	if (_unlikely(!label_oids)) {
+		Oid enumtypid = get_func_rettype(fcinfo->flinfo->fn_oid);
+		label_oids = MemoryContextAlloc(fcinfo->flinfo->fn_mcxt, n_labels * sizeof *label_oids);
+		for (size_t i = 0; i < n_labels; ++i)
+			if (_unlikely(!OidIsValid(label_oids[i] = GetSysCacheOid2(ENUMTYPOIDNAME, Anum_pg_enum_oid,
+					ObjectIdGetDatum(enumtypid), CStringGetDatum(labels[i])))))
+				ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("enum %s has no label \"%s\"", format_type_be(enumtypid), labels[i]));
+		fcinfo->flinfo->fn_extra = label_oids;
+	}
+	return ObjectIdGetDatum(label_oids[idx]);
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_type);
+Datum
+pg_bitcoin_address_type(PG_FUNCTION_ARGS)
+{
+	struct bitcoin_address_fields f;
+	unpack(&f, (const bitcoin_address *) PG_GETARG_POINTER(0));
+
+	return enum_label_datum(fcinfo, address_type_labels, sizeof address_type_labels / sizeof *address_type_labels,
+			classify_address_type(&f));
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_network);
+Datum
+pg_bitcoin_address_network(PG_FUNCTION_ARGS)
+{
+	struct bitcoin_address_fields f;
+	unpack(&f, (const bitcoin_address *) PG_GETARG_POINTER(0));
+
+	return enum_label_datum(fcinfo, address_network_labels, sizeof address_network_labels / sizeof *address_network_labels,
+			classify_network(&f));
+}
+
+
+/*
+ * A scriptPubKey is determined by the type of an address and the part of its program that is not a blinding key. Every SegWit
+ * address has one, but a legacy address has one only if its version is one of the known P2PKH or P2SH versions.
+ */
+#define BLINDING_KEY_SIZE 33 // compressed public key that precedes the program of a confidential address
+
+size_t
+script_pubkey(uint8 script[SCRIPT_PUBKEY_MAX_SIZE], const struct bitcoin_address_fields *f)
+{
+	if (f->hrp) {
+		const uint8 *program = f->program;
+		size_t n_program = f->n_program;
+		if (f->blech) {
+			if (_unlikely(n_program < BLINDING_KEY_SIZE))
+				return 0;
+			program += BLINDING_KEY_SIZE, n_program -= BLINDING_KEY_SIZE;
+		}
+		if (_unlikely(n_program > WITNESS_PROGRAM_MAX_SIZE || f->version > WITNESS_MAX_VERSION))
+			return 0;
+		script[0] = f->version ? (uint8) (OP_1 - 1 + f->version) : OP_0;
+		script[1] = (uint8) n_program;
+		memcpy(&script[2], program, n_program);
+		return 2 + n_program;
+	}
+	enum address_type type = classify_address_type(f);
+	// the hash of a blinded address follows the version of the unblinded address and the blinding key
+	const uint8 *hash = f->program + (f->n_program == LEGACY_BLINDED_PROGRAM_SIZE ? 1/*version*/ + BLINDING_KEY_SIZE : 0);
+	if (type == ADDRESS_TYPE_P2PKH || type == ADDRESS_TYPE_P2PKH_BLINDED) {
+		script[0] = OP_DUP, script[1] = OP_HASH160, script[2] = LEGACY_PROGRAM_SIZE;
+		memcpy(&script[3], hash, LEGACY_PROGRAM_SIZE);
+		script[23] = OP_EQUALVERIFY, script[24] = OP_CHECKSIG;
+		return P2PKH_SCRIPT_SIZE;
+	}
+	if (type == ADDRESS_TYPE_P2SH || type == ADDRESS_TYPE_P2SH_BLINDED) {
+		script[0] = OP_HASH160, script[1] = LEGACY_PROGRAM_SIZE;
+		memcpy(&script[2], hash, LEGACY_PROGRAM_SIZE);
+		script[22] = OP_EQUAL;
+		return P2SH_SCRIPT_SIZE;
+	}
+	return 0;
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_script_pubkey);
+Datum
+pg_bitcoin_address_script_pubkey(PG_FUNCTION_ARGS)
+{
+	struct bitcoin_address_fields f;
+	unpack(&f, PG_GETARG_VARLENA_PP(0));
+
+	uint8 script[SCRIPT_PUBKEY_MAX_SIZE];
+	size_t n_script = script_pubkey(script, &f);
+	if (!n_script)
+		PG_RETURN_NULL();
+	bytea *out = palloc(VARHDRSZ + n_script);
+	memcpy(VARDATA(out), script, n_script);
+	SET_VARSIZE(out, VARHDRSZ + n_script);
+	PG_RETURN_BYTEA_P(out);
+}
+
+/*
+ * The Electrum protocol identifies a script by its SHA-256 digest in reversed byte order, which is also the order in which
+ * Electrum servers display it in hexadecimal.
+ */
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_electrum_scripthash);
+Datum
+pg_bitcoin_address_electrum_scripthash(PG_FUNCTION_ARGS)
+{
+	struct bitcoin_address_fields f;
+	unpack(&f, PG_GETARG_VARLENA_PP(0));
+
+	uint8 script[SCRIPT_PUBKEY_MAX_SIZE];
+	size_t n_script = script_pubkey(script, &f);
+	if (!n_script)
+		PG_RETURN_NULL();
+	uint8 digest[SHA256_DIGEST_SIZE];
+	sha256(digest, script, n_script);
+	bytea *out = palloc(VARHDRSZ + SHA256_DIGEST_SIZE);
+	for (size_t i = 0; i < SHA256_DIGEST_SIZE; ++i)
+		((uint8 *) VARDATA(out))[i] = digest[SHA256_DIGEST_SIZE - 1 - i];
+	SET_VARSIZE(out, VARHDRSZ + SHA256_DIGEST_SIZE);
+	PG_RETURN_BYTEA_P(out);
+}
+
+// returns the index of the label of the given enum value in labels, or n_labels if it is not among them
+static size_t
+enum_label_index(Oid label_oid, const char *const labels[], size_t n_labels)
+{
+	HeapTuple tuple = SearchSysCache1(ENUMOID, ObjectIdGetDatum(label_oid));
+	if (_unlikely(!HeapTupleIsValid(tuple)))
+		elog(ERROR, "cache lookup failed for enum label %u", label_oid);
+	const char *label = NameStr(((Form_pg_enum) GETSTRUCT(tuple))->enumlabel);
+	size_t idx = 0;
+	while (idx < n_labels && strcmp(label, labels[idx]) != 0)
+		++idx;
+	ReleaseSysCache(tuple);
+	return idx;
+}
+
+enum address_type
+address_type_from_oid(Oid label_oid, struct enum_label_cache *cache)
+{
+	if (cache && cache->label_oid == label_oid)
+		return (enum address_type) cache->value;
+	size_t idx = enum_label_index(label_oid, address_type_labels, sizeof address_type_labels / sizeof *address_type_labels);
+	enum address_type type = idx < sizeof address_type_labels / sizeof *address_type_labels ?
+			(enum address_type) idx : ADDRESS_TYPE_UNKNOWN;
+	if (cache)
+		cache->label_oid = label_oid, cache->value = (int) type;
+	return type;
+}
+
+enum address_network
+address_network_from_oid(Oid label_oid, struct enum_label_cache *cache)
+{
+	if (cache && cache->label_oid == label_oid)
+		return (enum address_network) cache->value;
+	size_t idx = enum_label_index(label_oid, address_network_labels,
+			sizeof address_network_labels / sizeof *address_network_labels);
+	enum address_network network = idx < sizeof address_network_labels / sizeof *address_network_labels ?
+			(enum address_network) idx : ADDRESS_NETWORK_UNKNOWN;
+	if (cache)
+		cache->label_oid = label_oid, cache->value = (int) network;
+	return network;
+}
+
+bitcoin_address *
+script_address(const uint8 *script, size_t n_script, enum address_network network)
+{
+	struct bitcoin_address_fields f;
+	f.blech = false;
+	if (n_script == P2PKH_SCRIPT_SIZE && script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == LEGACY_PROGRAM_SIZE &&
+			script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG ||
+			n_script == P2SH_SCRIPT_SIZE && script[0] == OP_HASH160 && script[1] == LEGACY_PROGRAM_SIZE && script[22] == OP_EQUAL) {
+		bool pkh = n_script == P2PKH_SCRIPT_SIZE;
+		if (network == ADDRESS_NETWORK_REGTEST) // regtest shares the legacy versions of testnet
+			network = ADDRESS_NETWORK_TESTNET;
+		size_t i = 0;
+		while (i < sizeof legacy_versions / sizeof *legacy_versions && legacy_versions[i].network != network)
+			++i;
+		if (_unlikely(i == sizeof legacy_versions / sizeof *legacy_versions))
+			goto unknown_network;
+		f.well_known_hrp_idx = 0;
+		f.hrp = NULL, f.n_hrp = 0;
+		f.version = pkh ? legacy_versions[i].pkh : legacy_versions[i].sh;
+		f.program = &script[pkh ? 3 : 2], f.n_program = LEGACY_PROGRAM_SIZE;
+	}
+	else if (n_script >= 2 + WITNESS_PROGRAM_MIN_SIZE && n_script <= SCRIPT_PUBKEY_MAX_SIZE &&
+			(script[0] == OP_0 || script[0] >= OP_1 && script[0] <= OP_16) && script[1] == (uint8) (n_script - 2)) {
+		f.version = script[0] == OP_0 ? 0 : (uint8) (script[0] - (OP_1 - 1));
+		f.program = &script[2], f.n_program = n_script - 2;
+		if (f.version == 0 && f.n_program != WITNESS_PROGRAM_PKH_SIZE && f.n_program != WITNESS_PROGRAM_SH_SIZE)
+			return NULL;
+		size_t i = 0;
+		while (i < N_BUILTIN_HRPS && well_known_hrp_networks[i][0] != network)
+			++i;
+		if (_unlikely(i == N_BUILTIN_HRPS))
+			goto unknown_network;
+		f.well_known_hrp_idx = (int) i;
+		f.n_hrp = strlen(f.hrp = well_known_hrp[i]);
+	}
+	else
+		return NULL;
+
+	size_t n_out = packed_size(&f);
+	bitcoin_address *out = palloc(n_out);
+	pack(out, &f);
+
+	SET_VARSIZE(out, n_out);
+	return out;
+
+unknown_network:
+	ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			errmsg("network is not known"),
+			errhint("network must be one of mainnet, testnet, regtest, liquidv1, or liquidtestnet"));
+}
+
+// returns the unconfidential address that pays to a standard scriptPubKey on the given network, or NULL if there is none
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_from_script);
+Datum
+pg_bitcoin_address_from_script(PG_FUNCTION_ARGS)
+{
+	const bytea *arg = PG_GETARG_BYTEA_PP(0);
+	struct enum_label_cache *cache = fcinfo->flinfo->fn_extra;
+	if (_unlikely(!cache))
+		fcinfo->flinfo->fn_extra = cache = MemoryContextAllocZero(fcinfo->flinfo->fn_mcxt, sizeof *cache);
+	bitcoin_address *out = script_address((const uint8 *) VARDATA_ANY(arg), VARSIZE_ANY_EXHDR(arg),
+			address_network_from_oid(PG_GETARG_OID(1), cache));
+	if (!out)
+		PG_RETURN_NULL();
+	PG_RETURN_POINTER(out);
+}
+
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_hash);
+Datum
+pg_bitcoin_address_hash(PG_FUNCTION_ARGS)
+{
+	const bitcoin_address *arg = PG_GETARG_VARLENA_PP(0);
+
+	return hash_any((const unsigned char *) VARDATA_ANY(arg), (int) VARSIZE_ANY_EXHDR(arg));
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_hash_extended);
+Datum
+pg_bitcoin_address_hash_extended(PG_FUNCTION_ARGS)
+{
+	const bitcoin_address *arg = PG_GETARG_VARLENA_PP(0);
+
+	return hash_any_extended((const unsigned char *) VARDATA_ANY(arg), (int) VARSIZE_ANY_EXHDR(arg), PG_GETARG_INT64(1));
+}
+
+
+/*
+ * Abbreviated keys are formed from the leading bytes of the packed representation: the initial byte (legacy marker or HRP tag),
+ * the version, and the start of the program. These are almost always sufficient to resolve a comparison without consulting the
+ * full datums. The abbreviated keys compare as unsigned integers in the same order as byteacmp would compare the full datums.
+ */
+struct bitcoin_address_sortsupport_state {
+	hyperLogLogState abbr_card;
+	int64 input_count;
+};
+
+static int
+bitcoin_address_fastcmp(Datum x, Datum y, SortSupport ssup)
+{
+	(void) ssup;
+	bitcoin_address *a = PG_DETOAST_DATUM_PACKED(x), *b = PG_DETOAST_DATUM_PACKED(y);
+	size_t n_a = VARSIZE_ANY_EXHDR(a), n_b = VARSIZE_ANY_EXHDR(b);
+
+	int cmp = memcmp(VARDATA_ANY(a), VARDATA_ANY(b), Min(n_a, n_b));
+	if (cmp == 0)
+		cmp = (n_a > n_b) - (n_a < n_b);
+
+	if ((Pointer) a != DatumGetPointer(x)) pfree(a);
+	if ((Pointer) b != DatumGetPointer(y)) pfree(b);
+	return cmp;
+}
+
+static int __attribute__ ((__const__))
+bitcoin_address_abbrev_cmp(Datum x, Datum y, SortSupport ssup)
+{
+	(void) ssup;
+	return (x > y) - (x < y);
+}
+
+static Datum
+bitcoin_address_abbrev_convert(Datum original, SortSupport ssup)
+{
+	struct bitcoin_address_sortsupport_state *state = ssup->ssup_extra;
+	bitcoin_address *arg = PG_DETOAST_DATUM_PACKED(original);
+
+	Datum res = 0;
+	memcpy(&res, VARDATA_ANY(arg), Min(VARSIZE_ANY_EXHDR(arg), sizeof res));
+	res = DatumBigEndianToNative(res);
+
+#if SIZEOF_DATUM == 8
+	uint32 folded = (uint32) res ^ (uint32) (res >> 32);
+#else
+	uint32 folded = (uint32) res;
+#endif
+	addHyperLogLog(&state->abbr_card, DatumGetUInt32(hash_uint32(folded)));
+	++state->input_count;
+
+	if ((Pointer) arg != DatumGetPointer(original)) pfree(arg);
+	return res;
+}
+
+static bool
+bitcoin_address_abbrev_abort(int memtupcount, SortSupport ssup)
+{
+	struct bitcoin_address_sortsupport_state *state = ssup->ssup_extra;
+
+	if (memtupcount < 10000 || state->input_count < 10000)
+		return false;
+	// abort only if the abbreviated keys are hopelessly non-distinct
+	return estimateHyperLogLog(&state->abbr_card) < (double) state->input_count / 2000.0 + 0.5;
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_sortsupport);
+Datum
+pg_bitcoin_address_sortsupport(PG_FUNCTION_ARGS)
+{
+	SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+	ssup->comparator = &bitcoin_address_fastcmp;
+	if (ssup->abbreviate) {
+		MemoryContext oldcontext = MemoryContextSwitchTo(ssup->ssup_cxt);
+		struct bitcoin_address_sortsupport_state *state = palloc(sizeof *state);
+		initHyperLogLog(&state->abbr_card, 10);
+		state->input_count = 0;
+		ssup->ssup_extra = state;
+		ssup->abbrev_full_comparator = ssup->comparator;
+		ssup->comparator = &bitcoin_address_abbrev_cmp;
+		ssup->abbrev_converter = &bitcoin_address_abbrev_convert;
+		ssup->abbrev_abort = &bitcoin_address_abbrev_abort;
+		MemoryContextSwitchTo(oldcontext);
+	}
+	PG_RETURN_VOID();
+}
+
+
+/*
+ * The pattern operators compare addresses by their textual encodings, byte by byte, as text_pattern_ops compares text. In an index
+ * using bitcoin_address_pattern_ops, the addresses that begin with a given prefix therefore occupy a single range of keys. (No such
+ * range exists in the default operator class, which orders the packed representations: the leading Base58 digits of a legacy
+ * address depend on the length of its payload, and Bech32 and Blech32 addresses having the same HRP are stored under different tags.
+ * Nor can a prefix be translated into a bounded set of ranges of packed keys: an HRP stored inline may itself begin with any Bech32
+ * address prefix.)
+ *
+ * Encoding an address costs far more than comparing two encodings, so each pattern comparison caches the encodings of the last two
+ * distinct addresses it has seen, keyed on their packed representations. B-tree searches compare one search key against a series
+ * of index keys, and sorts compare one pivot or heap top against a series of other keys, so one side of each comparison is usually
+ * cached. The cache lives in fn_extra for the comparison functions and in ssup_extra for the sort comparator.
+ */
+struct pattern_text_cache_slot {
+	size_t n_key;
+	uint8 *key;
+	char *text; // NULL if the slot is empty
+};
+
+struct pattern_text_cache {
+	MemoryContext mcxt;
+	struct pattern_text_cache_slot slots[2];
+};
+
+static struct pattern_text_cache *
+pattern_text_cache_create(MemoryContext mcxt)
+{
+	struct pattern_text_cache *cache = MemoryContextAllocZero(mcxt, sizeof *cache);
+	cache->mcxt = mcxt;
+	return cache;
+}
+
+static struct pattern_text_cache *
+pattern_text_cache_get(FmgrInfo *flinfo)
+{
+	if (_unlikely(!flinfo->fn_extra))
+		flinfo->fn_extra = pattern_text_cache_create(flinfo->fn_mcxt);
+	return flinfo->fn_extra;
+}
+
+// returns the encoding of an address, which remains owned by the cache; on a miss, the slot of the given index is replaced
+static const char *
+pattern_text(struct pattern_text_cache *cache, size_t slot_idx, const bitcoin_address *arg)
+{
+	const uint8 *key = (const uint8 *) VARDATA_ANY(arg);
+	size_t n_key = VARSIZE_ANY_EXHDR(arg);
+	for (size_t i = 0; i < sizeof cache->slots / sizeof *cache->slots; ++i)
+		if (cache->slots[i].text && cache->slots[i].n_key == n_key && memcmp(cache->slots[i].key, key, n_key) == 0)
+			return cache->slots[i].text;
+
+	struct pattern_text_cache_slot *slot = &cache->slots[slot_idx];
+	if (slot->text) {
+		pfree(slot->key), pfree(slot->text);
+		slot->text = NULL;
+	}
+	char *out = format_bitcoin_address(arg);
+	slot->key = memcpy(MemoryContextAlloc(cache->mcxt, n_key), key, n_key);
+	slot->n_key = n_key;
+	slot->text = MemoryContextStrdup(cache->mcxt, out);
+	pfree(out);
+	return slot->text;
+}
+
+static int
+bitcoin_address_pattern_cmp_internal(Datum x, Datum y, struct pattern_text_cache *cache)
+{
+	bitcoin_address *a = PG_DETOAST_DATUM_PACKED(x), *b = PG_DETOAST_DATUM_PACKED(y);
+
+	int cmp = strcmp(pattern_text(cache, 0, a), pattern_text(cache, 1, b));
+
+	if ((Pointer) a != DatumGetPointer(x)) pfree(a);
+	if ((Pointer) b != DatumGetPointer(y)) pfree(b);
+	return cmp;
+}
+
+struct bitcoin_address_pattern_sortsupport_state {
+	struct bitcoin_address_sortsupport_state abbrev;
+	struct pattern_text_cache *cache;
+};
+
+static int
+bitcoin_address_pattern_fastcmp(Datum x, Datum y, SortSupport ssup)
+{
+	const struct bitcoin_address_pattern_sortsupport_state *state = ssup->ssup_extra;
+	return bitcoin_address_pattern_cmp_internal(x, y, state->cache);
+}
+
+static int
+bitcoin_address_text_pattern_cmp_internal(FunctionCallInfo fcinfo)
+{
+	const bitcoin_address *arg = PG_GETARG_VARLENA_PP(0);
+	const text *pattern = PG_GETARG_TEXT_PP(1);
+	size_t n_pattern = VARSIZE_ANY_EXHDR(pattern);
+	const char *out = pattern_text(pattern_text_cache_get(fcinfo->flinfo), 0, arg);
+	size_t n_out = strlen(out);
+
+	int cmp = memcmp(out, VARDATA_ANY(pattern), Min(n_out, n_pattern));
+	if (cmp == 0)
+		cmp = (n_out > n_pattern) - (n_out < n_pattern);
+	return cmp;
+}
+
+// abbreviated keys are the first bytes of the encodings, which strcmp orders exactly as it orders the encodings themselves
+static Datum
+bitcoin_address_pattern_abbrev_convert(Datum original, SortSupport ssup)
+{
+	struct bitcoin_address_pattern_sortsupport_state *state = ssup->ssup_extra;
+	bitcoin_address *arg = PG_DETOAST_DATUM_PACKED(original);
+	char *out = format_bitcoin_address(arg);
+
+	Datum res = 0;
+	memcpy(&res, out, Min(strlen(out), sizeof res));
+	res = DatumBigEndianToNative(res);
+
+#if SIZEOF_DATUM == 8
+	uint32 folded = (uint32) res ^ (uint32) (res >> 32);
+#else
+	uint32 folded = (uint32) res;
+#endif
+	addHyperLogLog(&state->abbrev.abbr_card, DatumGetUInt32(hash_uint32(folded)));
+	++state->abbrev.input_count;
+
+	pfree(out);
+	if ((Pointer) arg != DatumGetPointer(original)) pfree(arg);
+	return res;
+}
+
+static bool
+bitcoin_address_pattern_abbrev_abort(int memtupcount, SortSupport ssup)
+{
+	struct bitcoin_address_pattern_sortsupport_state *state = ssup->ssup_extra;
+
+	if (memtupcount < 10000 || state->abbrev.input_count < 10000)
+		return false;
+	return estimateHyperLogLog(&state->abbrev.abbr_card) < (double) state->abbrev.input_count / 2000.0 + 0.5;
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_pattern_sortsupport);
+Datum
+pg_bitcoin_address_pattern_sortsupport(PG_FUNCTION_ARGS)
+{
+	SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+	MemoryContext oldcontext = MemoryContextSwitchTo(ssup->ssup_cxt);
+	struct bitcoin_address_pattern_sortsupport_state *state = palloc(sizeof *state);
+	state->cache = pattern_text_cache_create(ssup->ssup_cxt);
+	ssup->ssup_extra = state;
+	ssup->comparator = &bitcoin_address_pattern_fastcmp;
+	if (ssup->abbreviate) {
+		initHyperLogLog(&state->abbrev.abbr_card, 10);
+		state->abbrev.input_count = 0;
+		ssup->abbrev_full_comparator = ssup->comparator;
+		ssup->comparator = &bitcoin_address_abbrev_cmp;
+		ssup->abbrev_converter = &bitcoin_address_pattern_abbrev_convert;
+		ssup->abbrev_abort = &bitcoin_address_pattern_abbrev_abort;
+	}
+	MemoryContextSwitchTo(oldcontext);
+	PG_RETURN_VOID();
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_pattern_cmp);
+Datum
+pg_bitcoin_address_pattern_cmp(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_INT32(bitcoin_address_pattern_cmp_internal(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1),
+			pattern_text_cache_get(fcinfo->flinfo)));
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_text_pattern_cmp);
+Datum
+pg_bitcoin_address_text_pattern_cmp(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_INT32(bitcoin_address_text_pattern_cmp_internal(fcinfo));
+}
+
+#define DEFINE_PATTERN_OPERATOR(name, op) \
+	PG_FUNCTION_INFO_V1(pg_bitcoin_address_pattern_##name); \
+	Datum \
+	pg_bitcoin_address_pattern_##name(PG_FUNCTION_ARGS) \
+	{ \
+		PG_RETURN_BOOL(bitcoin_address_pattern_cmp_internal(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1), \
+				pattern_text_cache_get(fcinfo->flinfo)) op 0); \
+	} \
+	\
+	PG_FUNCTION_INFO_V1(pg_bitcoin_address_text_pattern_##name); \
+	Datum \
+	pg_bitcoin_address_text_pattern_##name(PG_FUNCTION_ARGS) \
+	{ \
+		PG_RETURN_BOOL(bitcoin_address_text_pattern_cmp_internal(fcinfo) op 0); \
+	}
+
+DEFINE_PATTERN_OPERATOR(lt, <)
+DEFINE_PATTERN_OPERATOR(le, <=)
+DEFINE_PATTERN_OPERATOR(ge, >=)
+DEFINE_PATTERN_OPERATOR(gt, >)
+
+// equality of two bitcoin_address values is bytewise equality, which the pattern comparison agrees with, but an address and a text
+// are equal only if the text is exactly the address's encoding
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_text_pattern_eq);
+Datum
+pg_bitcoin_address_text_pattern_eq(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_BOOL(bitcoin_address_text_pattern_cmp_internal(fcinfo) == 0);
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_starts_with);
+Datum
+pg_bitcoin_address_starts_with(PG_FUNCTION_ARGS)
+{
+	const bitcoin_address *arg = PG_GETARG_VARLENA_PP(0);
+	const text *prefix = PG_GETARG_TEXT_PP(1);
+	size_t n_prefix = VARSIZE_ANY_EXHDR(prefix);
+	char *out = format_bitcoin_address(arg);
+
+	bool result = strlen(out) >= n_prefix && memcmp(out, VARDATA_ANY(prefix), n_prefix) == 0;
+
+	pfree(out);
+	PG_RETURN_BOOL(result);
+}
+
+/*
+ * Translates "address ^@ 'prefix'" and "starts_with(address, 'prefix')" into "address ~>=~ 'prefix' AND address ~<~ 'prefiy'" when
+ * the address is the key of an index whose operator family provides pattern comparisons against text. The range is exact, so the
+ * original clause need not be rechecked.
+ */
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_starts_with_support);
+Datum
+pg_bitcoin_address_starts_with_support(PG_FUNCTION_ARGS)
+{
+	Node *rawreq = (Node *) PG_GETARG_POINTER(0);
+
+	if (!IsA(rawreq, SupportRequestIndexCondition))
+		PG_RETURN_POINTER(NULL);
+	SupportRequestIndexCondition *req = (SupportRequestIndexCondition *) rawreq;
+	if (req->indexarg != 0 || req->index->relam != BTREE_AM_OID)
+		PG_RETURN_POINTER(NULL);
+	List *args;
+	Oid inputcollid;
+	if (is_opclause(req->node)) {
+		const OpExpr *clause = (const OpExpr *) req->node;
+		args = clause->args, inputcollid = clause->inputcollid;
+	}
+	else if (is_funcclause(req->node)) { // starts_with(address, prefix)
+		const FuncExpr *clause = (const FuncExpr *) req->node;
+		args = clause->args, inputcollid = clause->inputcollid;
+	}
+	else
+		PG_RETURN_POINTER(NULL);
+	if (list_length(args) != 2)
+		PG_RETURN_POINTER(NULL);
+	Expr *leftop = linitial(args);
+	Const *rightop = lsecond(args);
+	if (!IsA(rightop, Const) || rightop->constisnull)
+		PG_RETURN_POINTER(NULL);
+
+	Oid type = exprType((Node *) leftop);
+	Oid ge_op = get_opfamily_member(req->opfamily, type, TEXTOID, BTGreaterEqualStrategyNumber),
+		lt_op = get_opfamily_member(req->opfamily, type, TEXTOID, BTLessStrategyNumber);
+	if (!OidIsValid(ge_op) || !OidIsValid(lt_op))
+		PG_RETURN_POINTER(NULL);
+
+	const text *prefix = DatumGetTextPP(rightop->constvalue);
+	const char *p = VARDATA_ANY(prefix);
+	size_t n_prefix = VARSIZE_ANY_EXHDR(prefix);
+	if (n_prefix == 0)
+		PG_RETURN_POINTER(NULL); // every address matches
+
+	List *result = list_make1(make_opclause(ge_op, BOOLOID, false, leftop, (Expr *) rightop, InvalidOid, inputcollid));
+
+	// the upper bound is the prefix with its last byte incremented, after dropping any trailing bytes that cannot be incremented
+	while (n_prefix > 0 && (uint8) p[n_prefix - 1] == UINT8_MAX)
+		--n_prefix;
+	if (n_prefix > 0) {
+		text *upper = cstring_to_text_with_len(p, (int) n_prefix);
+		char *last = VARDATA(upper) + n_prefix - 1;
+		*last = (char) ((uint8) *last + 1);
+		Const *bound = makeConst(TEXTOID, -1, rightop->constcollid, -1, PointerGetDatum(upper), false, false);
+		result = lappend(result, make_opclause(lt_op, BOOLOID, false, leftop, (Expr *) bound, InvalidOid, inputcollid));
+	}
+
+	req->lossy = false;
+	PG_RETURN_POINTER(result);
+}
+
+
+/*
+ * Each classification predicate accepts the addresses whose network is in a set of networks and whose type is in a set of types.
+ * The predicates are implemented in C rather than SQL so that the planner does not inline them, which lets their support function
+ * estimate their selectivity from the classification statistics gathered by bitcoin_address_typanalyze.
+ */
+#define NETWORK_MASK(network) (UINT32_C(1) << ADDRESS_NETWORK_##network)
+#define TYPE_MASK(type) (UINT32_C(1) << ADDRESS_TYPE_##type | UINT32_C(1) << ADDRESS_TYPE_##type##_BLINDED)
+#define ALL_NETWORKS ((UINT32_C(1) << N_ADDRESS_NETWORKS) - 1)
+#define ALL_TYPES ((UINT32_C(1) << N_ADDRESS_TYPES) - 1)
+#define BLINDED_TYPES (ALL_TYPES & ~((UINT32_C(1) << ADDRESS_TYPE_P2PKH_BLINDED) - 1))
+
+#define N_ADDRESS_TYPES (sizeof address_type_labels / sizeof *address_type_labels)
+#define N_ADDRESS_NETWORKS (sizeof address_network_labels / sizeof *address_network_labels)
+
+#define ADDRESS_PREDICATES(X) \
+	X(is_mainnet, NETWORK_MASK(MAINNET), ALL_TYPES) \
+	X(is_testnet, NETWORK_MASK(TESTNET), ALL_TYPES) \
+	X(is_liquidv1, NETWORK_MASK(LIQUIDV1), ALL_TYPES) \
+	X(is_liquidtestnet, NETWORK_MASK(LIQUIDTESTNET), ALL_TYPES) \
+	X(is_p2pkh, ALL_NETWORKS, TYPE_MASK(P2PKH)) \
+	X(is_p2sh, ALL_NETWORKS, TYPE_MASK(P2SH)) \
+	X(is_p2wpkh, ALL_NETWORKS, TYPE_MASK(P2WPKH)) \
+	X(is_p2wsh, ALL_NETWORKS, TYPE_MASK(P2WSH)) \
+	X(is_p2tr, ALL_NETWORKS, TYPE_MASK(P2TR)) \
+	X(is_blinding, ALL_NETWORKS, BLINDED_TYPES)
+
+static const struct address_predicate {
+	const char *prosrc;
+	uint32 networks, types;
+} address_predicates[] = {
+#define X(name, networks, types) { "pg_bitcoin_address_" #name, networks, types },
+	ADDRESS_PREDICATES(X)
+#undef X
+};
+
+#define X(name, networks, types) \
+	PG_FUNCTION_INFO_V1(pg_bitcoin_address_##name); \
+	Datum __attribute__ ((__pure__)) \
+	pg_bitcoin_address_##name(PG_FUNCTION_ARGS) \
+	{ \
+		struct bitcoin_address_fields f; \
+		unpack(&f, (const bitcoin_address *) PG_GETARG_POINTER(0)); \
+	\
+		PG_RETURN_BOOL((networks) >> classify_network(&f) & 1 && (types) >> classify_address_type(&f) & 1); \
+	}
+ADDRESS_PREDICATES(X)
+#undef X
+
+
+/*
+ * In addition to the standard scalar statistics, ANALYZE gathers the fraction of sampled rows falling into each combination of
+ * network and address type, stored in a statistics slot of the following private kind. The fractions are of all sampled rows,
+ * including nulls, and are laid out as stanumbers[network * N_ADDRESS_TYPES + type].
+ */
+#define STATISTIC_KIND_BITCOIN_ADDRESS_CLASSES 10173
+
+static AnalyzeAttrComputeStatsFunc std_compute_stats;
+
+static void
+compute_bitcoin_address_stats(VacAttrStats *stats, AnalyzeAttrFetchFunc fetchfunc, int samplerows, double totalrows)
+{
+	(*std_compute_stats)(stats, fetchfunc, samplerows, totalrows);
+	if (!stats->stats_valid)
+		return;
+
+	int slot_idx = 0;
+	while (stats->stakind[slot_idx] != 0)
+		if (++slot_idx >= STATISTIC_NUM_SLOTS)
+			return;
+
+	int counts[N_ADDRESS_NETWORKS * N_ADDRESS_TYPES] = { 0 };
+	for (int i = 0; i < samplerows; ++i) {
+		bool isnull;
+		Datum value = (*fetchfunc)(stats, i, &isnull);
+		if (isnull)
+			continue;
+		bitcoin_address *arg = PG_DETOAST_DATUM_PACKED(value);
+		struct bitcoin_address_fields f;
+		unpack(&f, arg);
+		++counts[classify_network(&f) * N_ADDRESS_TYPES + classify_address_type(&f)];
+		if ((Pointer) arg != DatumGetPointer(value)) pfree(arg);
+	}
+
+	MemoryContext oldcontext = MemoryContextSwitchTo(stats->anl_context);
+	float4 *numbers = palloc(sizeof counts / sizeof *counts * sizeof *numbers);
+	for (size_t i = 0; i < sizeof counts / sizeof *counts; ++i)
+		numbers[i] = (float4) ((double) counts[i] / (double) samplerows);
+	MemoryContextSwitchTo(oldcontext);
+
+	stats->stakind[slot_idx] = STATISTIC_KIND_BITCOIN_ADDRESS_CLASSES;
+	stats->staop[slot_idx] = InvalidOid;
+	stats->stanumbers[slot_idx] = numbers;
+	stats->numnumbers[slot_idx] = (int) (sizeof counts / sizeof *counts);
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_typanalyze);
+Datum
+pg_bitcoin_address_typanalyze(PG_FUNCTION_ARGS)
+{
+	VacAttrStats *stats = (VacAttrStats *) PG_GETARG_POINTER(0);
+
+	if (!std_typanalyze(stats))
+		PG_RETURN_BOOL(false);
+	std_compute_stats = stats->compute_stats;
+	stats->compute_stats = &compute_bitcoin_address_stats;
+	PG_RETURN_BOOL(true);
+}
+
+static const struct address_predicate *
+find_address_predicate(Oid funcid)
+{
+	HeapTuple tuple = SearchSysCache1(PROCOID, ObjectIdGetDatum(funcid));
+	if (!HeapTupleIsValid(tuple))
+		return NULL;
+	bool isnull;
+	Datum prosrc = SysCacheGetAttr(PROCOID, tuple, Anum_pg_proc_prosrc, &isnull);
+	const struct address_predicate *predicate = NULL;
+	if (!isnull) {
+		char *symbol = TextDatumGetCString(prosrc);
+		for (size_t i = 0; i < sizeof address_predicates / sizeof *address_predicates; ++i)
+			if (strcmp(symbol, address_predicates[i].prosrc) == 0) {
+				predicate = &address_predicates[i];
+				break;
+			}
+		pfree(symbol);
+	}
+	ReleaseSysCache(tuple);
+	return predicate;
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_predicate_support);
+Datum
+pg_bitcoin_address_predicate_support(PG_FUNCTION_ARGS)
+{
+	Node *rawreq = (Node *) PG_GETARG_POINTER(0);
+
+	if (!IsA(rawreq, SupportRequestSelectivity))
+		PG_RETURN_POINTER(NULL);
+	SupportRequestSelectivity *req = (SupportRequestSelectivity *) rawreq;
+	if (req->is_join || list_length(req->args) != 1)
+		PG_RETURN_POINTER(NULL);
+	const struct address_predicate *predicate = find_address_predicate(req->funcid);
+	if (!predicate)
+		PG_RETURN_POINTER(NULL);
+
+	VariableStatData vardata;
+	examine_variable(req->root, linitial(req->args), req->varRelid, &vardata);
+	bool found = false;
+	if (HeapTupleIsValid(vardata.statsTuple)) {
+		AttStatsSlot sslot;
+		if (get_attstatsslot(&sslot, vardata.statsTuple, STATISTIC_KIND_BITCOIN_ADDRESS_CLASSES, InvalidOid, ATTSTATSSLOT_NUMBERS)) {
+			if (sslot.nnumbers == (int) (N_ADDRESS_NETWORKS * N_ADDRESS_TYPES)) {
+				double selec = 0.0;
+				for (size_t network = 0; network < N_ADDRESS_NETWORKS; ++network)
+					if (predicate->networks >> network & 1)
+						for (size_t type = 0; type < N_ADDRESS_TYPES; ++type)
+							if (predicate->types >> type & 1)
+								selec += (double) sslot.numbers[network * N_ADDRESS_TYPES + type];
+				CLAMP_PROBABILITY(selec);
+				req->selectivity = (Selectivity) selec;
+				found = true;
+			}
+			free_attstatsslot(&sslot);
+		}
+	}
+	ReleaseVariableStats(vardata);
+
+	PG_RETURN_POINTER(found ? req : NULL);
+}
+
+
+/*
+ * A type modifier restricts bitcoin_address values to a set of networks, a set of address types, or both, as in
+ * bitcoin_address(mainnet) or bitcoin_address(mainnet, p2wpkh, p2tr). The typmod holds the network mask in its low byte and the
+ * type mask above that, with an omitted category admitting all of its members. The "unknown" labels are not accepted as modifiers.
+ */
+#define TYPMOD_NETWORKS(typmod) ((uint32) (typmod) & 0xFF)
+#define TYPMOD_TYPES(typmod) ((uint32) (typmod) >> 8)
+
+StaticAssertDecl(N_ADDRESS_NETWORKS <= 8 && N_ADDRESS_TYPES <= 23, "typmod cannot hold the network and type masks");
+
+static char *
+format_typmod(int32 typmod)
+{
+	StringInfoData buf;
+	initStringInfo(&buf);
+	if (typmod >= 0) {
+		char separator = '(';
+		if (TYPMOD_NETWORKS(typmod) != ALL_NETWORKS)
+			for (size_t i = 0; i < N_ADDRESS_NETWORKS; ++i)
+				if (TYPMOD_NETWORKS(typmod) >> i & 1)
+					appendStringInfo(&buf, "%c%s", separator, address_network_labels[i]), separator = ',';
+		if (TYPMOD_TYPES(typmod) != ALL_TYPES)
+			for (size_t i = 0; i < N_ADDRESS_TYPES; ++i)
+				if (TYPMOD_TYPES(typmod) >> i & 1)
+					appendStringInfo(&buf, "%c%s", separator, address_type_labels[i]), separator = ',';
+		appendStringInfoChar(&buf, ')');
+	}
+	return buf.data;
+}
+
+static bool
+check_typmod(const bitcoin_address *value, int32 typmod, struct Node *escontext)
+{
+	if (typmod < 0)
+		return true;
+	struct bitcoin_address_fields f;
+	unpack(&f, value);
+	enum address_network network = classify_network(&f);
+	enum address_type type = classify_address_type(&f);
+	if (_likely(TYPMOD_NETWORKS(typmod) >> network & 1 && TYPMOD_TYPES(typmod) >> type & 1))
+		return true;
+	ereturn(escontext, false, errcode(ERRCODE_CHECK_VIOLATION),
+			errmsg("bitcoin_address is not permitted by type modifier %s", format_typmod(typmod)),
+			errdetail("The address is of type %s on network %s.", address_type_labels[type], address_network_labels[network]));
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_typmod_in);
+Datum
+pg_bitcoin_address_typmod_in(PG_FUNCTION_ARGS)
+{
+	ArrayType *arr = PG_GETARG_ARRAYTYPE_P(0);
+	Datum *elems;
+	int n_elems;
+	deconstruct_array(arr, CSTRINGOID, -2, false, TYPALIGN_CHAR, &elems, NULL, &n_elems);
+
+	uint32 networks = 0, types = 0;
+	for (int i = 0; i < n_elems; ++i) {
+		const char *modifier = DatumGetCString(elems[i]);
+		size_t j;
+		for (j = 1; j < N_ADDRESS_NETWORKS; ++j)
+			if (strcmp(modifier, address_network_labels[j]) == 0) {
+				networks |= UINT32_C(1) << j;
+				break;
+			}
+		if (j < N_ADDRESS_NETWORKS)
+			continue;
+		for (j = 1; j < N_ADDRESS_TYPES; ++j)
+			if (strcmp(modifier, address_type_labels[j]) == 0) {
+				types |= UINT32_C(1) << j;
+				break;
+			}
+		if (_unlikely(j == N_ADDRESS_TYPES))
+			ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					errmsg("invalid type modifier \"%s\" for type bitcoin_address", modifier),
+					errhint("Type modifiers are address networks and address types, such as mainnet or p2wpkh."));
+	}
+	PG_RETURN_INT32((int32) ((networks ? networks : ALL_NETWORKS) | (types ? types : ALL_TYPES) << 8));
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_typmod_out);
+Datum
+pg_bitcoin_address_typmod_out(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_CSTRING(format_typmod(PG_GETARG_INT32(0)));
+}
+
+// implements the cast from bitcoin_address to bitcoin_address that applies a typmod
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_coerce);
+Datum
+pg_bitcoin_address_coerce(PG_FUNCTION_ARGS)
+{
+	check_typmod(PG_GETARG_VARLENA_PP(0), PG_GETARG_INT32(1), NULL);
+	PG_RETURN_DATUM(PG_GETARG_DATUM(0));
+}
+
+// removes coercions to typmods that admit every value of the source expression
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_coerce_support);
+Datum
+pg_bitcoin_address_coerce_support(PG_FUNCTION_ARGS)
+{
+	Node *rawreq = (Node *) PG_GETARG_POINTER(0);
+
+	if (!IsA(rawreq, SupportRequestSimplify))
+		PG_RETURN_POINTER(NULL);
+	FuncExpr *expr = ((SupportRequestSimplify *) rawreq)->fcall;
+	Node *source = linitial(expr->args);
+	Const *typmod = lsecond(expr->args);
+	if (!IsA(typmod, Const) || typmod->constisnull)
+		PG_RETURN_POINTER(NULL);
+
+	int32 new_typmod = DatumGetInt32(typmod->constvalue), old_typmod = exprTypmod(source);
+	if (new_typmod < 0 || old_typmod >= 0 &&
+			!(TYPMOD_NETWORKS(old_typmod) & ~TYPMOD_NETWORKS(new_typmod)) && !(TYPMOD_TYPES(old_typmod) & ~TYPMOD_TYPES(new_typmod)))
+		PG_RETURN_POINTER(relabel_to_typmod(source, new_typmod));
+	PG_RETURN_POINTER(NULL);
+}
@@ -0,0 +1,233 @@
+#include <postgres.h>
+#if HAVE_VARATT_H
+# include <varatt.h>
+#endif
+
+#include <bech32.h>
+
+#include "hrp_registry.h"
+
+#define _likely(...) __builtin_expect(!!(__VA_ARGS__), 1)
+#define _unlikely(...) __builtin_expect(!!(__VA_ARGS__), 0)
+
+#pragma GCC visibility push(hidden)
+
+typedef struct varlena bitcoin_address;
+
+// version of the binary wire format used by the send and receive functions
+#define BITCOIN_ADDRESS_BINARY_FORMAT 1
+
+struct bitcoin_address_fields {
+	bool blech;
+	uint8 version;
+	int well_known_hrp_idx;
+	const char *hrp;
+	size_t n_hrp;
+	const uint8 *program;
+	size_t n_program;
+};
+
+/*
+ * In memory and on disk, a bitcoin_address consists of an initial HRP length byte, followed by that many bytes of HRP, followed by
+ * the 1-byte witness version, followed by the witness program. If the initial byte is 0xFF, it signifies a legacy address, in
+ * which case the bytes that follow are exactly the bytes to be encoded in Base58Check. If the initial byte is between 84 and 0x7F,
+ * it signifies a Blech32-encoded address, and the initial byte minus 83 gives the length of the HRP, except if the initial byte is
+ * 0x7F, in which case the next two bytes give the length of the HRP (in network byte order). As an optimization, if the initial
+ * byte has a value between 0x80 and 0xFE, then bit 6 indicates whether the encoding uses Blech32, the lower 6 bits give an index
+ * into the table of well-known HRPs below (or, beyond its end, into the HRP registry), and no explicit HRP is stored.
+ */
+static const char *const well_known_hrp[] = { // DO NOT RE-ORDER!
+	// see SLIP-0173: Registered human-readable parts for BIP-0173
+	"bc", // Bitcoin Mainnet
+	"tb", // Bitcoin Testnet
+	"bcrt", // Bitcoin Regtest
+	"ex", // Liquidv1 explicit
+	"lq", // Liquidv1
+	"tex", // Liquid Testnet explicit
+	"tlq", // Liquid Testnet
+};
+
+#define N_BUILTIN_HRPS (sizeof well_known_hrp / sizeof *well_known_hrp)
+
+static inline ssize_t find_well_known_hrp(const char *hrp, size_t n_hrp) {
+	for (size_t i = 0; i < N_BUILTIN_HRPS; ++i)
+		if (strncasecmp(hrp, well_known_hrp[i], n_hrp) == 0 && well_known_hrp[i][n_hrp] == '\0')
+			return (ssize_t) i;
+	return hrp_registry_find(hrp, n_hrp);
+}
+
+// tells whether a packed representation without its varlena header refers to its HRP by a registry index
+static inline bool __attribute__ ((__pure__)) uses_registered_hrp(const uint8 *data, size_t n_data) {
+	return n_data >= 1 && data[0] >= 0x80 && data[0] != 0xFF && (size_t) (data[0] - 0x80) % 0x40 >= N_BUILTIN_HRPS;
+}
+
+/*
+ * Unpacks the fields of a packed representation without its varlena header. Returns NULL on success or else a description of the
+ * problem that completes the sentence "The bitcoin_address ...". Unpacking a value whose HRP is registered may read the registry
+ * table (see hrp_registry.h) and can therefore raise an error. The comparison, hashing, sort support, and index support functions
+ * work on the packed bytes and never unpack.
+ */
+static inline const char * unpack_data(struct bitcoin_address_fields *restrict f, const uint8 *data, size_t n_data) {
+	if (_unlikely(n_data < 1/*n_hrp*/ + 1/*version*/))
+		return "is corrupted";
+	size_t n_hrp = *data++; --n_data;
+	if (n_hrp == 0xFF) { // legacy address
+		f->blech = false;
+		f->well_known_hrp_idx = 0;
+		f->hrp = NULL;
+		f->n_hrp = 0;
+	}
+	else if (n_hrp >= 0x80) { // well-known HRP
+		if (f->blech = (n_hrp -= 0x80) >= 0x40)
+			n_hrp -= 0x40;
+		f->well_known_hrp_idx = (int) n_hrp;
+		if (_likely(n_hrp < N_BUILTIN_HRPS))
+			f->n_hrp = strlen(f->hrp = well_known_hrp[n_hrp]);
+		else if (_unlikely(!(f->hrp = hrp_registry_hrp(n_hrp, &f->n_hrp))))
+			return "uses unknown human-readable prefix";
+	}
+	else if (_unlikely(n_hrp == 0))
+		return "is corrupted";
+	else {
+		if (f->blech = n_hrp > BECH32_HRP_MAX_SIZE) { // blinding address
+			if (n_hrp == 0x7F) { // HRP length stored in next 2 bytes
+				if (_unlikely(n_data < 2))
+					return "is corrupted";
+				n_hrp = data[0] << 8 | data[1];
+				data += 2, n_data -= 2;
+			}
+			else
+				n_hrp -= BECH32_HRP_MAX_SIZE;
+		}
+		if (_unlikely(n_data < n_hrp + 1/*version*/))
+			return "is corrupted";
+		f->well_known_hrp_idx = -1;
+		f->hrp = (const char *) data, f->n_hrp = n_hrp;
+		data += n_hrp, n_data -= n_hrp;
+	}
+	f->version = *data++, --n_data;
+	f->program = data, f->n_program = n_data;
+	return NULL;
+}
+
+/*
+ * Returns the number of bytes that precede the program in a packed representation without its varlena header, given only its first
+ * n_data bytes, or 0 if that cannot be determined from those bytes.
+ */
+static inline size_t __attribute__ ((__pure__)) packed_header_size(const uint8 *data, size_t n_data) {
+	if (n_data < 1)
+		return 0;
+	size_t n_hrp = data[0];
+	if (n_hrp >= 0x80) // legacy address or well-known HRP
+		return 1/*initial byte*/ + 1/*version*/;
+	if (n_hrp <= BECH32_HRP_MAX_SIZE)
+		return n_hrp ? 1/*initial byte*/ + n_hrp + 1/*version*/ : 0;
+	if (n_hrp < 0x7F)
+		return 1/*initial byte*/ + n_hrp - BECH32_HRP_MAX_SIZE + 1/*version*/;
+	if (n_data < 3)
+		return 0;
+	return 3/*initial byte and HRP length*/ + (size_t) (data[1] << 8 | data[2]) + 1/*version*/;
+}
+
+#define SCRIPT_PUBKEY_MAX_SIZE (2 + WITNESS_PROGRAM_MAX_SIZE)
+#define P2PKH_SCRIPT_SIZE 25
+#define P2SH_SCRIPT_SIZE 23
+
+enum {
+	OP_0 = 0x00,
+	OP_1 = 0x51,
+	OP_16 = 0x60,
+	OP_DUP = 0x76,
+	OP_EQUAL = 0x87,
+	OP_EQUALVERIFY = 0x88,
+	OP_HASH160 = 0xA9,
+	OP_CHECKSIG = 0xAC,
+};
+
+// writes the scriptPubKey of an address and returns its size, or returns 0 if the address has no known scriptPubKey
+size_t script_pubkey(uint8 script[SCRIPT_PUBKEY_MAX_SIZE], const struct bitcoin_address_fields *f)
+	__attribute__ ((__access__ (write_only, 1), __nonnull__));
+
+// the order must match the labels of the address_type enum in SQL
+enum address_type {
+	ADDRESS_TYPE_UNKNOWN,
+	ADDRESS_TYPE_P2PKH,
+	ADDRESS_TYPE_P2SH,
+	ADDRESS_TYPE_P2WPKH,
+	ADDRESS_TYPE_P2WSH,
+	ADDRESS_TYPE_P2TR,
+	ADDRESS_TYPE_P2PKH_BLINDED,
+	ADDRESS_TYPE_P2SH_BLINDED,
+	ADDRESS_TYPE_P2WPKH_BLINDED,
+	ADDRESS_TYPE_P2WSH_BLINDED,
+	ADDRESS_TYPE_P2TR_BLINDED,
+};
+
+// the order must match the labels of the address_network enum in SQL
+enum address_network {
+	ADDRESS_NETWORK_UNKNOWN,
+	ADDRESS_NETWORK_MAINNET,
+	ADDRESS_NETWORK_TESTNET,
+	ADDRESS_NETWORK_REGTEST,
+	ADDRESS_NETWORK_LIQUIDV1,
+	ADDRESS_NETWORK_LIQUIDTESTNET,
+};
+
+/*
+ * Remembers the last enum value converted by address_type_from_oid or address_network_from_oid, so that a caller converting the
+ * same argument on every call can keep one in its fn_extra state and look the label up in the syscache only once.
+ */
+struct enum_label_cache {
+	Oid label_oid; // InvalidOid if nothing is cached
+	int value;
+};
+
+// returns the address type named by a value of the address_type enum; cache may be NULL
+enum address_type address_type_from_oid(Oid label_oid, struct enum_label_cache *cache);
+
+// returns the network named by a value of the address_network enum; cache may be NULL
+enum address_network address_network_from_oid(Oid label_oid, struct enum_label_cache *cache);
+
+/*
+ * Returns the unconfidential address that pays to a standard scriptPubKey on the given network, or NULL if the script is not of a
+ * standard form that has an address.
+ */
+bitcoin_address * script_address(const uint8 *script, size_t n_script, enum address_network network)
+	__attribute__ ((__access__ (read_only, 1, 2)));
+
+static inline void unpack(struct bitcoin_address_fields *restrict f, const bitcoin_address *restrict arg) {
+	const char *problem = unpack_data(f, (const uint8 *) VARDATA_ANY(arg), VARSIZE_ANY_EXHDR(arg));
+	if (_unlikely(problem))
+		ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				errmsg("stored bitcoin_address %s", problem));
+}
+
+// returns the size of the packed representation of the given fields, including the varlena header
+static inline size_t __attribute__ ((__pure__)) packed_size(const struct bitcoin_address_fields *f) {
+	return VARHDRSZ + 1/*initial byte*/ +
+			(f->hrp && f->well_known_hrp_idx < 0 ? (f->blech && BECH32_HRP_MAX_SIZE + f->n_hrp >= 0x7F ? 2 : 0) + f->n_hrp : 0) +
+			1/*version*/ + f->n_program;
+}
+
+static inline void pack(bitcoin_address *restrict out, const struct bitcoin_address_fields *restrict f) {
+	uint8 *data = (uint8 *) VARDATA(out);
+	if (!f->hrp) // legacy address
+		*data++ = 0xFF;
+	else if (f->well_known_hrp_idx >= 0)
+		*data++ = (uint8) (f->well_known_hrp_idx + 0x80 + (f->blech ? 0x40 : 0));
+	else {
+		if (!f->blech)
+			*data++ = (uint8) f->n_hrp;
+		else if (BECH32_HRP_MAX_SIZE + f->n_hrp < 0x7F)
+			*data++ = (uint8) (BECH32_HRP_MAX_SIZE + f->n_hrp);
+		else
+			*data++ = 0x7F, *data++ = (uint8) (f->n_hrp >> 8), *data++ = (uint8) f->n_hrp;
+		for (size_t i = 0; i < f->n_hrp; ++i)
+			*data++ = (uint8) (f->hrp[i] | (f->hrp[i] >= 'A' && f->hrp[i] <= 'Z' ? 0x20 : 0));
+	}
+	*data++ = (uint8) f->version;
+	if (f->program != data)
+		memcpy(data, f->program, f->n_program);
+}
+
+#pragma GCC visibility pop
@@ -0,0 +1,309 @@
+#include <postgres.h>
+#include <fmgr.h>
+
+#include <access/spgist.h>
+#include <access/stratnum.h>
+#include <catalog/pg_type.h>
+#include <utils/datum.h>
+
+#include "bitcoin_address.h"
+
+
+/*
+ * The SP-GiST operator class is a radix tree over the packed representation of bitcoin_address, in the manner of the built-in
+ * text_ops operator class. The packed representation begins with the HRP tag (or legacy marker) and the version, which together
+ * take few distinct values, so the upper levels of the tree partition the addresses by network and version, and the lower levels
+ * by the bytes of the program. A search for a program prefix thus descends every (network, version) branch, which are few, and
+ * then follows only the nodes that agree with the prefix. Inner tuples hold a common prefix (as bytea) and nodes labeled with the
+ * next byte, or with -1 for the end of a value, or with -2 for the dummy node used when a tuple whose nodes are all the same must
+ * be split. Leaf tuples hold the remaining suffix. Scans reconstruct the full values, so index-only scans are possible.
+ */
+
+#define SPGIST_MAX_PREFIX_LENGTH Max((int) (BLCKSZ - 258 * 16 - 100), 32)
+
+// strategy number of the program prefix operator (^@); the equality operator uses BTEqualStrategyNumber
+#define PROGRAM_PREFIX_STRATEGY_NUMBER RTPrefixStrategyNumber
+
+static Datum
+form_varlena_datum(const void *data, size_t n_data)
+{
+	char *p = palloc(VARHDRSZ + n_data);
+	if (VARHDRSZ_SHORT + n_data <= VARATT_SHORTVARLENA_THRESHOLD) {
+		SET_VARSIZE_SHORT(p, VARHDRSZ_SHORT + n_data);
+		memcpy(p + VARHDRSZ_SHORT, data, n_data);
+	}
+	else {
+		SET_VARSIZE(p, VARHDRSZ + n_data);
+		memcpy(p + VARHDRSZ, data, n_data);
+	}
+	return PointerGetDatum(p);
+}
+
+static size_t
+common_prefix_size(const uint8 *a, const uint8 *b, size_t n_a, size_t n_b)
+{
+	size_t i = 0, n = Min(n_a, n_b);
+	while (i < n && a[i] == b[i])
+		++i;
+	return i;
+}
+
+// finds a node label in the sorted array of labels, or else the index at which it would be inserted
+static bool
+search_label(const Datum *labels, int n_labels, int16 label, int *idx)
+{
+	int lo = 0, hi = n_labels;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		int16 mid_label = DatumGetInt16(labels[mid]);
+		if (mid_label == label) {
+			*idx = mid;
+			return true;
+		}
+		if (mid_label < label)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*idx = lo;
+	return false;
+}
+
+/*
+ * Tests whether a value whose first n_key bytes are given can satisfy the scan keys. If complete is true, then the value consists
+ * of exactly those bytes; otherwise, more bytes may follow.
+ */
+static bool
+keys_consistent(const ScanKey scankeys, int nkeys, const uint8 *key, size_t n_key, bool complete)
+{
+	for (int i = 0; i < nkeys; ++i) {
+		const struct varlena *arg = PG_DETOAST_DATUM_PACKED(scankeys[i].sk_argument);
+		const uint8 *query = (const uint8 *) VARDATA_ANY(arg);
+		size_t n_query = VARSIZE_ANY_EXHDR(arg);
+		switch (scankeys[i].sk_strategy) {
+			case BTEqualStrategyNumber:
+				if (complete ? n_key != n_query : n_key > n_query)
+					return false;
+				if (memcmp(key, query, n_key) != 0)
+					return false;
+				break;
+			case PROGRAM_PREFIX_STRATEGY_NUMBER: {
+				size_t n_header = packed_header_size(key, n_key);
+				if (n_header == 0 || n_header > n_key) {
+					if (complete) // not a valid packed representation
+						return false;
+					break; // the program has not begun
+				}
+				size_t n_program = n_key - n_header;
+				if (complete && n_program < n_query)
+					return false;
+				if (memcmp(key + n_header, query, Min(n_program, n_query)) != 0)
+					return false;
+				break;
+			}
+			default:
+				elog(ERROR, "unrecognized strategy number: %d", scankeys[i].sk_strategy);
+		}
+	}
+	return true;
+}
+
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_spgist_config);
+Datum
+pg_bitcoin_address_spgist_config(PG_FUNCTION_ARGS)
+{
+	const spgConfigIn *in = (const spgConfigIn *) PG_GETARG_POINTER(0);
+	spgConfigOut *cfg = (spgConfigOut *) PG_GETARG_POINTER(1);
+
+	cfg->prefixType = BYTEAOID;
+	cfg->labelType = INT2OID;
+	cfg->leafType = in->attType;
+	cfg->canReturnData = true;
+	cfg->longValuesOK = true;
+	PG_RETURN_VOID();
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_spgist_choose);
+Datum
+pg_bitcoin_address_spgist_choose(PG_FUNCTION_ARGS)
+{
+	const spgChooseIn *in = (const spgChooseIn *) PG_GETARG_POINTER(0);
+	spgChooseOut *out = (spgChooseOut *) PG_GETARG_POINTER(1);
+	const bitcoin_address *arg = DatumGetPointer(in->datum);
+	const uint8 *data = (const uint8 *) VARDATA_ANY(arg) + in->level;
+	size_t n_data = VARSIZE_ANY_EXHDR(arg) - (size_t) in->level;
+
+	size_t n_common = 0;
+	int16 label;
+	if (in->hasPrefix) {
+		const bytea *prefix = DatumGetPointer(in->prefixDatum);
+		const uint8 *p = (const uint8 *) VARDATA_ANY(prefix);
+		size_t n_prefix = VARSIZE_ANY_EXHDR(prefix);
+		n_common = common_prefix_size(data, p, n_data, n_prefix);
+		if (n_common < n_prefix) { // the new value diverges within the prefix, so the inner tuple must be split there
+			out->resultType = spgSplitTuple;
+			if ((out->result.splitTuple.prefixHasPrefix = n_common > 0))
+				out->result.splitTuple.prefixPrefixDatum = form_varlena_datum(p, n_common);
+			out->result.splitTuple.prefixNNodes = 1;
+			out->result.splitTuple.prefixNodeLabels = palloc(sizeof(Datum));
+			out->result.splitTuple.prefixNodeLabels[0] = Int16GetDatum(p[n_common]);
+			out->result.splitTuple.childNodeN = 0;
+			if ((out->result.splitTuple.postfixHasPrefix = n_prefix - n_common > 1))
+				out->result.splitTuple.postfixPrefixDatum = form_varlena_datum(p + n_common + 1, n_prefix - n_common - 1);
+			PG_RETURN_VOID();
+		}
+	}
+	label = n_data > n_common ? data[n_common] : -1;
+
+	int idx;
+	if (search_label(in->nodeLabels, in->nNodes, label, &idx)) {
+		// if the tuple is all the same, the core code chooses the node itself, but levelAdd and restDatum are the same regardless
+		size_t level_add = n_common + (label >= 0);
+		out->resultType = spgMatchNode;
+		out->result.matchNode.nodeN = idx;
+		out->result.matchNode.levelAdd = (int) level_add;
+		out->result.matchNode.restDatum = form_varlena_datum(data + level_add, n_data - level_add);
+	}
+	else if (in->allTheSame) {
+		// cannot add a node to an all-the-same tuple, so push its nodes down under a dummy node
+		out->resultType = spgSplitTuple;
+		out->result.splitTuple.prefixHasPrefix = in->hasPrefix;
+		out->result.splitTuple.prefixPrefixDatum = in->prefixDatum;
+		out->result.splitTuple.prefixNNodes = 1;
+		out->result.splitTuple.prefixNodeLabels = palloc(sizeof(Datum));
+		out->result.splitTuple.prefixNodeLabels[0] = Int16GetDatum(-2);
+		out->result.splitTuple.childNodeN = 0;
+		out->result.splitTuple.postfixHasPrefix = false;
+	}
+	else {
+		out->resultType = spgAddNode;
+		out->result.addNode.nodeLabel = Int16GetDatum(label);
+		out->result.addNode.nodeN = idx;
+	}
+	PG_RETURN_VOID();
+}
+
+struct spgist_split_item {
+	int16 label;
+	int idx;
+	const struct varlena *value;
+};
+
+static int
+compare_split_items(const void *a, const void *b)
+{
+	const struct spgist_split_item *x = a, *y = b;
+	return (x->label > y->label) - (x->label < y->label);
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_spgist_picksplit);
+Datum
+pg_bitcoin_address_spgist_picksplit(PG_FUNCTION_ARGS)
+{
+	const spgPickSplitIn *in = (const spgPickSplitIn *) PG_GETARG_POINTER(0);
+	spgPickSplitOut *out = (spgPickSplitOut *) PG_GETARG_POINTER(1);
+
+	const struct varlena *first = DatumGetPointer(in->datums[0]);
+	size_t n_common = VARSIZE_ANY_EXHDR(first);
+	for (int i = 1; i < in->nTuples && n_common > 0; ++i) {
+		const struct varlena *value = DatumGetPointer(in->datums[i]);
+		n_common = common_prefix_size((const uint8 *) VARDATA_ANY(first), (const uint8 *) VARDATA_ANY(value),
+				n_common, VARSIZE_ANY_EXHDR(value));
+	}
+	// limit the prefix so that the inner tuple fits on a page
+	n_common = Min(n_common, (size_t) SPGIST_MAX_PREFIX_LENGTH);
+	if ((out->hasPrefix = n_common > 0))
+		out->prefixDatum = form_varlena_datum(VARDATA_ANY(first), n_common);
+
+	// group the values by the first byte after the common prefix, sorting so that the node labels are in order
+	struct spgist_split_item *items = palloc(sizeof *items * (size_t) in->nTuples);
+	for (int i = 0; i < in->nTuples; ++i) {
+		const struct varlena *value = DatumGetPointer(in->datums[i]);
+		items[i].label = VARSIZE_ANY_EXHDR(value) > n_common ? ((const uint8 *) VARDATA_ANY(value))[n_common] : -1;
+		items[i].idx = i;
+		items[i].value = value;
+	}
+	qsort(items, (size_t) in->nTuples, sizeof *items, &compare_split_items);
+
+	out->nNodes = 0;
+	out->nodeLabels = palloc(sizeof(Datum) * (size_t) in->nTuples);
+	out->mapTuplesToNodes = palloc(sizeof(int) * (size_t) in->nTuples);
+	out->leafTupleDatums = palloc(sizeof(Datum) * (size_t) in->nTuples);
+	for (int i = 0; i < in->nTuples; ++i) {
+		if (i == 0 || items[i].label != items[i - 1].label)
+			out->nodeLabels[out->nNodes++] = Int16GetDatum(items[i].label);
+		size_t n_value = VARSIZE_ANY_EXHDR(items[i].value), n_skip = n_common + (items[i].label >= 0);
+		out->leafTupleDatums[items[i].idx] = form_varlena_datum((const uint8 *) VARDATA_ANY(items[i].value) + n_skip, n_value - n_skip);
+		out->mapTuplesToNodes[items[i].idx] = out->nNodes - 1;
+	}
+	pfree(items);
+	PG_RETURN_VOID();
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_spgist_inner_consistent);
+Datum
+pg_bitcoin_address_spgist_inner_consistent(PG_FUNCTION_ARGS)
+{
+	const spgInnerConsistentIn *in = (const spgInnerConsistentIn *) PG_GETARG_POINTER(0);
+	spgInnerConsistentOut *out = (spgInnerConsistentOut *) PG_GETARG_POINTER(1);
+	const struct varlena *reconstructed = DatumGetPointer(in->reconstructedValue);
+	size_t level = (size_t) in->level;
+	Assert(reconstructed ? VARSIZE_ANY_EXHDR(reconstructed) == level : level == 0);
+
+	// the bytes of the values below each node are those reconstructed so far, then the prefix, then the node label
+	size_t n_prefix = 0;
+	const bytea *prefix = NULL;
+	if (in->hasPrefix) {
+		prefix = DatumGetPointer(in->prefixDatum);
+		n_prefix = VARSIZE_ANY_EXHDR(prefix);
+	}
+	size_t n_max = level + n_prefix + 1/*label*/;
+	struct varlena *value = palloc(VARHDRSZ + n_max);
+	uint8 *data = (uint8 *) VARDATA(value);
+	if (level)
+		memcpy(data, VARDATA_ANY(reconstructed), level);
+	if (n_prefix)
+		memcpy(data + level, VARDATA_ANY(prefix), n_prefix);
+
+	out->nodeNumbers = palloc(sizeof(int) * (size_t) in->nNodes);
+	out->levelAdds = palloc(sizeof(int) * (size_t) in->nNodes);
+	out->reconstructedValues = palloc(sizeof(Datum) * (size_t) in->nNodes);
+	out->nNodes = 0;
+	for (int i = 0; i < in->nNodes; ++i) {
+		int16 label = DatumGetInt16(in->nodeLabels[i]);
+		size_t n_value = n_max - 1;
+		if (label >= 0)
+			data[n_value++] = (uint8) label;
+		if (keys_consistent(in->scankeys, in->nkeys, data, n_value, label == -1)) {
+			SET_VARSIZE(value, VARHDRSZ + n_value);
+			out->nodeNumbers[out->nNodes] = i;
+			out->levelAdds[out->nNodes] = (int) (n_value - level);
+			out->reconstructedValues[out->nNodes] = datumCopy(PointerGetDatum(value), false, -1);
+			++out->nNodes;
+		}
+	}
+	pfree(value);
+	PG_RETURN_VOID();
+}
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_spgist_leaf_consistent);
+Datum
+pg_bitcoin_address_spgist_leaf_consistent(PG_FUNCTION_ARGS)
+{
+	const spgLeafConsistentIn *in = (const spgLeafConsistentIn *) PG_GETARG_POINTER(0);
+	spgLeafConsistentOut *out = (spgLeafConsistentOut *) PG_GETARG_POINTER(1);
+	const struct varlena *reconstructed = DatumGetPointer(in->reconstructedValue);
+	const struct varlena *leaf = DatumGetPointer(in->leafDatum);
+	size_t level = (size_t) in->level, n_leaf = VARSIZE_ANY_EXHDR(leaf);
+
+	bitcoin_address *value = palloc(VARHDRSZ + level + n_leaf);
+	SET_VARSIZE(value, VARHDRSZ + level + n_leaf);
+	if (level)
+		memcpy(VARDATA(value), VARDATA_ANY(reconstructed), level);
+	memcpy(VARDATA(value) + level, VARDATA_ANY(leaf), n_leaf);
+
+	out->leafValue = PointerGetDatum(value);
+	out->recheck = false;
+	PG_RETURN_BOOL(keys_consistent(in->scankeys, in->nkeys, (const uint8 *) VARDATA(value), level + n_leaf, true));
+}
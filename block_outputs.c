@@ -0,0 +1,186 @@
+#include <postgres.h>
+#include <fmgr.h>
+#include <funcapi.h>
+
+#include <access/htup_details.h>
+#include <utils/builtins.h>
+
+#include "bitcoin_address.h"
+#include "sha256.h"
+
+
+/*
+ * Parses a serialized block in place and returns one row per transaction output. The block is detoasted once, and each
+ * transaction is scanned when its first output is reached, to find its outputs and compute its txid; the outputs are then
+ * returned one per call. Transactions in the BIP144 extended serialization are recognized by their marker and flag bytes, and
+ * their txids are computed over the legacy serialization, without the marker, flag, and witnesses.
+ */
+#define BLOCK_HEADER_SIZE 80
+#define OUTPOINT_SIZE 36
+#define TXID_SIZE SHA256_DIGEST_SIZE
+
+struct block_parser {
+	const uint8 *data;
+	size_t n_data, pos;
+	uint64 n_txs_left;
+	enum address_network network;
+
+	// the transaction whose outputs are being returned
+	uint8 txid[TXID_SIZE];
+	size_t output_pos;
+	uint64 n_outputs_left;
+	uint32 vout;
+};
+
+static void __attribute__ ((__noreturn__))
+block_truncated(void)
+{
+	ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+			errmsg("raw block is truncated"));
+}
+
+// returns the offset of the n bytes at the parser's position and advances past them
+static inline size_t
+skip_bytes(struct block_parser *p, uint64 n)
+{
+	if (_unlikely(n > p->n_data - p->pos))
+		block_truncated();
+	size_t pos = p->pos;
+	p->pos += (size_t) n;
+	return pos;
+}
+
+static inline uint64
+read_le(struct block_parser *p, size_t n)
+{
+	const uint8 *in = &p->data[skip_bytes(p, n)];
+	uint64 v = 0;
+	for (size_t i = 0; i < n; ++i)
+		v |= (uint64) in[i] << (8 * i);
+	return v;
+}
+
+static inline uint64
+read_compact_size(struct block_parser *p)
+{
+	uint8 first = (uint8) read_le(p, 1);
+	return first < 0xFD ? first : read_le(p, (size_t) 2 << (first - 0xFD));
+}
+
+// scans the transaction at the parser's position, which becomes the current transaction
+static void
+begin_transaction(struct block_parser *p)
+{
+	size_t start = skip_bytes(p, sizeof(uint32)/*version*/);
+	bool extended = p->n_data - p->pos >= 2 && p->data[p->pos] == 0x00;
+	if (extended) {
+		if (_unlikely(p->data[p->pos + 1] != 0x01))
+			ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					errmsg("raw block contains a transaction with unknown optional data"));
+		p->pos += 2;
+	}
+	size_t body_start = p->pos;
+	uint64 n_inputs = read_compact_size(p);
+	for (uint64 i = 0; i < n_inputs; ++i) {
+		skip_bytes(p, OUTPOINT_SIZE);
+		skip_bytes(p, read_compact_size(p));
+		skip_bytes(p, sizeof(uint32)/*sequence*/);
+	}
+	p->n_outputs_left = read_compact_size(p);
+	p->output_pos = p->pos;
+	for (uint64 i = 0; i < p->n_outputs_left; ++i) {
+		skip_bytes(p, sizeof(int64)/*value*/);
+		skip_bytes(p, read_compact_size(p));
+	}
+	size_t body_end = p->pos;
+	if (extended)
+		for (uint64 i = 0; i < n_inputs; ++i)
+			for (uint64 n_items = read_compact_size(p); n_items > 0; --n_items)
+				skip_bytes(p, read_compact_size(p));
+	size_t locktime = skip_bytes(p, sizeof(uint32));
+
+	if (!extended)
+		sha256d(p->txid, &p->data[start], p->pos - start);
+	else {
+		struct sha256_ctx ctx;
+		uint8 digest[SHA256_DIGEST_SIZE];
+		sha256_begin(&ctx);
+		sha256_update(&ctx, &p->data[start], sizeof(uint32));
+		sha256_update(&ctx, &p->data[body_start], body_end - body_start);
+		sha256_update(&ctx, &p->data[locktime], sizeof(uint32));
+		sha256_end(&ctx, digest);
+		sha256(p->txid, digest, sizeof digest);
+	}
+	p->vout = 0;
+	--p->n_txs_left;
+}
+
+PG_FUNCTION_INFO_V1(pg_block_outputs);
+Datum
+pg_block_outputs(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *funcctx;
+	if (SRF_IS_FIRSTCALL()) {
+		funcctx = SRF_FIRSTCALL_INIT();
+		MemoryContext oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		TupleDesc tupdesc;
+		if (_unlikely(get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE))
+			ereport(ERROR, errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("function returning record called in context that cannot accept type record"));
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+		struct block_parser *p = palloc(sizeof *p);
+		p->network = address_network_from_oid(PG_GETARG_OID(1), NULL); // once per call
+		if (_unlikely(p->network != ADDRESS_NETWORK_MAINNET && p->network != ADDRESS_NETWORK_TESTNET &&
+				p->network != ADDRESS_NETWORK_REGTEST))
+			ereport(ERROR, errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("blocks of this network cannot be parsed"),
+					errhint("network must be one of mainnet, testnet, or regtest"));
+		const bytea *block = PG_GETARG_BYTEA_PP(0); // detoasted into the multi-call context, if necessary
+		p->data = (const uint8 *) VARDATA_ANY(block);
+		p->n_data = VARSIZE_ANY_EXHDR(block);
+		p->pos = 0;
+		skip_bytes(p, BLOCK_HEADER_SIZE);
+		p->n_txs_left = read_compact_size(p);
+		p->n_outputs_left = 0;
+		funcctx->user_fctx = p;
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+	funcctx = SRF_PERCALL_SETUP();
+	struct block_parser *p = funcctx->user_fctx;
+
+	while (p->n_outputs_left == 0) {
+		if (p->n_txs_left == 0) {
+			if (_unlikely(p->pos != p->n_data))
+				ereport(ERROR, errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+						errmsg("raw block has %zu bytes of trailing data", p->n_data - p->pos));
+			SRF_RETURN_DONE(funcctx);
+		}
+		begin_transaction(p);
+	}
+
+	// the outputs were bounds-checked when the transaction was scanned
+	size_t tx_pos = p->pos;
+	p->pos = p->output_pos;
+	int64 value = (int64) read_le(p, sizeof(int64));
+	uint64 n_script = read_compact_size(p);
+	const uint8 *script = &p->data[skip_bytes(p, n_script)];
+	p->output_pos = p->pos, p->pos = tx_pos;
+
+	bytea *txid = palloc(VARHDRSZ + TXID_SIZE);
+	SET_VARSIZE(txid, VARHDRSZ + TXID_SIZE);
+	memcpy(VARDATA(txid), p->txid, TXID_SIZE);
+	bitcoin_address *address = script_address(script, (size_t) n_script, p->network);
+
+	Datum values[] = {
+		PointerGetDatum(txid),
+		Int32GetDatum((int32) p->vout),
+		Int64GetDatum(value),
+		PointerGetDatum(address),
+	};
+	bool nulls[sizeof values / sizeof *values] = { [3] = !address };
+	++p->vout, --p->n_outputs_left;
+	SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(heap_form_tuple(funcctx->tuple_desc, values, nulls)));
+}
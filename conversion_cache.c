@@ -0,0 +1,109 @@
+#include <postgres.h>
+#include <fmgr.h>
+#include <funcapi.h>
+
+#include <access/htup_details.h>
+#include <common/hashfn.h>
+#include <utils/guc.h>
+
+#include "conversion_cache.h"
+
+#define _likely(...) __builtin_expect(!!(__VA_ARGS__), 1)
+#define _unlikely(...) __builtin_expect(!!(__VA_ARGS__), 0)
+
+
+static int conversion_cache_size = 0;
+
+// backend-local counters, reported by bitcoin_address_conversion_cache_stats()
+static uint64 cache_hits[2], cache_misses[2];
+
+struct conversion_cache_slot {
+	uint32 hash;
+	uint32 n_key;
+	uint32 n_value;
+	char *data; // key followed by value, or NULL if the slot is empty
+};
+
+struct conversion_cache {
+	MemoryContext mcxt;
+	enum conversion_cache_kind kind;
+	uint32 n_slots;
+	struct conversion_cache_slot slots[FLEXIBLE_ARRAY_MEMBER];
+};
+
+void
+conversion_cache_init(void)
+{
+	DefineCustomIntVariable("bitcoin_address.conversion_cache_size",
+			"Sets the number of conversion results cached per call site.",
+			"Repeated conversions of the same addresses between text and bitcoin_address within a query are served from "
+			"the cache. Zero disables caching.",
+			&conversion_cache_size, 0, 0, 1 << 20, PGC_USERSET, 0, NULL, NULL, NULL);
+#if PG_VERSION_NUM >= 150000
+	MarkGUCPrefixReserved("bitcoin_address");
+#else
+	EmitWarningsOnPlaceholders("bitcoin_address");
+#endif
+}
+
+struct conversion_cache *
+conversion_cache_get(FmgrInfo *flinfo, enum conversion_cache_kind kind)
+{
+	struct conversion_cache *cache = flinfo->fn_extra;
+	if (_likely(cache))
+		return cache->n_slots ? cache : NULL;
+	uint32 n_slots = (uint32) conversion_cache_size;
+	cache = MemoryContextAllocZero(flinfo->fn_mcxt, offsetof(struct conversion_cache, slots) + n_slots * sizeof *cache->slots);
+	cache->mcxt = flinfo->fn_mcxt;
+	cache->kind = kind;
+	cache->n_slots = n_slots;
+	flinfo->fn_extra = cache;
+	return n_slots ? cache : NULL;
+}
+
+const void *
+conversion_cache_lookup(struct conversion_cache *cache, const void *key, size_t n_key, size_t *n_value)
+{
+	uint32 hash = hash_bytes(key, (int) n_key);
+	const struct conversion_cache_slot *slot = &cache->slots[hash % cache->n_slots];
+	if (slot->data && slot->hash == hash && slot->n_key == n_key && memcmp(slot->data, key, n_key) == 0) {
+		++cache_hits[cache->kind];
+		*n_value = slot->n_value;
+		return slot->data + n_key;
+	}
+	++cache_misses[cache->kind];
+	return NULL;
+}
+
+void
+conversion_cache_store(struct conversion_cache *cache, const void *key, size_t n_key, const void *value, size_t n_value)
+{
+	uint32 hash = hash_bytes(key, (int) n_key);
+	struct conversion_cache_slot *slot = &cache->slots[hash % cache->n_slots];
+	if (slot->data)
+		pfree(slot->data);
+	slot->data = MemoryContextAlloc(cache->mcxt, n_key + n_value);
+	memcpy(slot->data, key, n_key);
+	memcpy(slot->data + n_key, value, n_value);
+	slot->hash = hash, slot->n_key = (uint32) n_key, slot->n_value = (uint32) n_value;
+}
+
+
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_conversion_cache_stats);
+Datum
+pg_bitcoin_address_conversion_cache_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc tupdesc;
+	if (_unlikely(get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE))
+		ereport(ERROR, errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("function returning record called in context that cannot accept type record"));
+
+	Datum values[] = {
+		Int64GetDatum((int64) cache_hits[CONVERSION_CACHE_INPUT]),
+		Int64GetDatum((int64) cache_misses[CONVERSION_CACHE_INPUT]),
+		Int64GetDatum((int64) cache_hits[CONVERSION_CACHE_OUTPUT]),
+		Int64GetDatum((int64) cache_misses[CONVERSION_CACHE_OUTPUT]),
+	};
+	bool nulls[sizeof values / sizeof *values] = { 0 };
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(BlessTupleDesc(tupdesc), values, nulls)));
+}
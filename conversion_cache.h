@@ -0,0 +1,32 @@
+#include <postgres.h>
+#include <fmgr.h>
+
+#pragma GCC visibility push(hidden)
+
+/*
+ * A small direct-mapped cache of conversion results, kept in fn_extra so that it lives as long as the query's call site. Keys and
+ * values are arbitrary byte strings. The number of slots is given by the bitcoin_address.conversion_cache_size setting at the time
+ * of the first call; a size of zero disables caching.
+ */
+enum conversion_cache_kind {
+	CONVERSION_CACHE_INPUT,
+	CONVERSION_CACHE_OUTPUT,
+};
+
+struct conversion_cache;
+
+// registers the configuration setting; called at module load
+void conversion_cache_init(void);
+
+// returns the cache for the given call site, or NULL if caching is disabled
+struct conversion_cache * conversion_cache_get(FmgrInfo *flinfo, enum conversion_cache_kind kind)
+	__attribute__ ((__nonnull__));
+
+// returns the cached value for a key and sets *n_value to its size, or returns NULL if the key is not cached
+const void * conversion_cache_lookup(struct conversion_cache *cache, const void *key, size_t n_key, size_t *n_value)
+	__attribute__ ((__access__ (read_only, 2, 3), __access__ (write_only, 4), __nonnull__));
+
+void conversion_cache_store(struct conversion_cache *cache, const void *key, size_t n_key, const void *value, size_t n_value)
+	__attribute__ ((__access__ (read_only, 2, 3), __access__ (read_only, 4, 5), __nonnull__));
+
+#pragma GCC visibility pop
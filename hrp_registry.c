@@ -0,0 +1,313 @@
+#include <postgres.h>
+#include <fmgr.h>
+
+#include <access/genam.h>
+#include <access/htup_details.h>
+#include <access/stratnum.h>
+#include <access/table.h>
+#include <access/xact.h>
+#include <catalog/pg_extension.h>
+#include <catalog/pg_type.h>
+#include <commands/extension.h>
+#include <commands/trigger.h>
+#include <executor/spi.h>
+#include <nodes/pg_list.h>
+#include <utils/builtins.h>
+#include <utils/fmgroids.h>
+#include <utils/guc.h>
+#include <utils/inval.h>
+#include <utils/lsyscache.h>
+#include <utils/memutils.h>
+#include <utils/rel.h>
+#include <utils/syscache.h>
+
+#include "bitcoin_address.h"
+#include "hrp_registry.h"
+
+#define _likely(...) __builtin_expect(!!(__VA_ARGS__), 1)
+#define _unlikely(...) __builtin_expect(!!(__VA_ARGS__), 0)
+
+
+#define REGISTRY_EXTENSION "pg_bitcoin_address"
+#define REGISTRY_TABLE "bitcoin_address_hrp_registry"
+
+// number of slots in the perfect hash table; with at most 56 keys, a random seed is collision-free with probability about 0.2
+#define HASH_SLOTS 1024
+#define MAX_SEEDS 4096
+
+static struct {
+	bool valid;
+	Oid relid; // InvalidOid if the table did not exist when the registry was last loaded
+	uint32 seed;
+	uint8 slots[HASH_SLOTS]; // registered index plus one, or zero if the slot is empty
+	const char *hrps[HRP_REGISTRY_MAX_IDX + 1];
+	uint8 n_hrps[HRP_REGISTRY_MAX_IDX + 1];
+} registry;
+
+// every HRP string ever loaded; never freed, since callers may hold pointers to them across a reload
+static List *interned_hrps;
+
+static const char *
+intern_hrp(const char *str)
+{
+	ListCell *lc;
+	foreach(lc, interned_hrps)
+		if (strcmp(lfirst(lc), str) == 0)
+			return lfirst(lc);
+	MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	char *copy = pstrdup(str);
+	interned_hrps = lappend(interned_hrps, copy);
+	MemoryContextSwitchTo(oldcontext);
+	return copy;
+}
+
+// forgets the loaded registrations, which may include some made by transactions that have since rolled back
+static void
+reset_registry(void)
+{
+	registry.valid = false;
+	registry.seed = 0;
+	memset(registry.slots, 0, sizeof registry.slots);
+	memset(registry.hrps, 0, sizeof registry.hrps);
+	memset(registry.n_hrps, 0, sizeof registry.n_hrps);
+}
+
+static uint32 __attribute__ ((__pure__))
+hash_hrp(const char *hrp, size_t n_hrp, uint32 seed)
+{
+	uint32 h = 0x811C9DC5 ^ seed; // FNV-1a over the lowercased HRP, then a MurmurHash3 finalizer
+	for (size_t i = 0; i < n_hrp; ++i)
+		h = (h ^ (uint8) (hrp[i] | (hrp[i] >= 'A' && hrp[i] <= 'Z' ? 0x20 : 0))) * 0x01000193;
+	h ^= h >> 16, h *= 0x85EBCA6B, h ^= h >> 13, h *= 0xC2B2AE35, h ^= h >> 16;
+	return h % HASH_SLOTS;
+}
+
+#if PG_VERSION_NUM < 160000
+static Oid
+get_extension_schema(Oid ext_oid)
+{
+	Relation rel = table_open(ExtensionRelationId, AccessShareLock);
+	ScanKeyData key;
+	ScanKeyInit(&key, Anum_pg_extension_oid, BTEqualStrategyNumber, F_OIDEQ, ObjectIdGetDatum(ext_oid));
+	SysScanDesc scan = systable_beginscan(rel, ExtensionOidIndexId, true, NULL, 1, &key);
+	HeapTuple tuple = systable_getnext(scan);
+	Oid result = HeapTupleIsValid(tuple) ? ((Form_pg_extension) GETSTRUCT(tuple))->extnamespace : InvalidOid;
+	systable_endscan(scan);
+	table_close(rel, AccessShareLock);
+	return result;
+}
+#endif
+
+static Oid
+find_registry_table(void)
+{
+	Oid ext_oid = get_extension_oid(REGISTRY_EXTENSION, true);
+	if (!OidIsValid(ext_oid))
+		return InvalidOid;
+	Oid nsp_oid = get_extension_schema(ext_oid);
+	return OidIsValid(nsp_oid) ? get_relname_relid(REGISTRY_TABLE, nsp_oid) : InvalidOid;
+}
+
+// rebuilds the mirror from scratch; if this raises an error, the mirror is left invalid and is rebuilt on next use
+static void
+load_registry(void)
+{
+	reset_registry();
+	registry.relid = find_registry_table();
+	if (OidIsValid(registry.relid)) {
+		Relation rel = table_open(registry.relid, AccessShareLock);
+		SysScanDesc scan = systable_beginscan(rel, InvalidOid, false, NULL, 0, NULL);
+		HeapTuple tuple;
+		while (HeapTupleIsValid(tuple = systable_getnext(scan))) {
+			bool idx_isnull, hrp_isnull;
+			Datum idx = heap_getattr(tuple, 1, RelationGetDescr(rel), &idx_isnull);
+			Datum hrp = heap_getattr(tuple, 2, RelationGetDescr(rel), &hrp_isnull);
+			if (idx_isnull || hrp_isnull || DatumGetInt16(idx) < HRP_REGISTRY_MIN_IDX ||
+					DatumGetInt16(idx) > HRP_REGISTRY_MAX_IDX || registry.hrps[DatumGetInt16(idx)])
+				continue;
+			char *str = TextDatumGetCString(hrp);
+			registry.n_hrps[DatumGetInt16(idx)] = (uint8) strlen(str);
+			registry.hrps[DatumGetInt16(idx)] = intern_hrp(str);
+			pfree(str);
+		}
+		systable_endscan(scan);
+		table_close(rel, AccessShareLock);
+	}
+
+	for (registry.seed = 0; registry.seed < MAX_SEEDS; ++registry.seed) {
+		memset(registry.slots, 0, sizeof registry.slots);
+		size_t idx;
+		for (idx = HRP_REGISTRY_MIN_IDX; idx <= HRP_REGISTRY_MAX_IDX; ++idx) {
+			if (!registry.hrps[idx])
+				continue;
+			uint8 *slot = &registry.slots[hash_hrp(registry.hrps[idx], registry.n_hrps[idx], registry.seed)];
+			if (*slot)
+				break;
+			*slot = (uint8) (idx + 1);
+		}
+		if (idx > HRP_REGISTRY_MAX_IDX) {
+			registry.valid = true;
+			return;
+		}
+	}
+	elog(ERROR, "could not construct a perfect hash of the registered human-readable prefixes");
+}
+
+// loads the registry if necessary; returns false if it cannot be loaded at this time
+static inline bool
+ensure_registry(void)
+{
+	if (_unlikely(!registry.valid)) {
+		if (!IsTransactionState())
+			return false;
+		load_registry();
+	}
+	return true;
+}
+
+static void
+invalidate_registry(Datum arg, Oid relid)
+{
+	(void) arg;
+	if (relid == InvalidOid || relid == registry.relid || !OidIsValid(registry.relid))
+		reset_registry();
+}
+
+void
+hrp_registry_init(void)
+{
+	CacheRegisterRelcacheCallback(invalidate_registry, (Datum) 0);
+}
+
+ssize_t
+hrp_registry_find(const char *hrp, size_t n_hrp)
+{
+	if (!ensure_registry())
+		return -1;
+	uint8 slot = registry.slots[hash_hrp(hrp, n_hrp, registry.seed)];
+	if (slot && registry.n_hrps[slot - 1] == n_hrp && pg_strncasecmp(hrp, registry.hrps[slot - 1], n_hrp) == 0)
+		return slot - 1;
+	return -1;
+}
+
+const char *
+hrp_registry_hrp(size_t idx, size_t *n_hrp)
+{
+	if (idx < HRP_REGISTRY_MIN_IDX || idx > HRP_REGISTRY_MAX_IDX || !ensure_registry())
+		return NULL;
+	if (_unlikely(!registry.hrps[idx]) && IsTransactionState())
+		load_registry(); // perhaps registered by a transaction whose invalidation we have not yet processed
+	*n_hrp = registry.n_hrps[idx];
+	return registry.hrps[idx];
+}
+
+/*
+ * Sets *lower and *upper to packed values that bound every value storing the given lowercase HRP inline with the given encoding.
+ * Comparisons are bytewise, and such values all begin with the same initial byte (or bytes) and HRP, so no other value falls
+ * between these bounds, and a B-tree index on the column finds them without reading any others.
+ */
+static void
+inline_hrp_bounds(Datum *lower, Datum *upper, const char *hrp, bool blech)
+{
+	struct bitcoin_address_fields f = {
+		.blech = blech, .well_known_hrp_idx = -1, .hrp = hrp, .n_hrp = strlen(hrp), .program = (const uint8 *) "",
+	};
+	size_t n = packed_size(&f);
+	bitcoin_address *lo = palloc(n), *hi = palloc(n);
+	pack(lo, &f);
+	SET_VARSIZE(lo, n);
+	memcpy(hi, lo, n);
+	++VARDATA(hi)[n - VARHDRSZ - 1/*version*/ - 1]; // HRP characters are at most '~', so this cannot carry
+	*lower = PointerGetDatum(lo), *upper = PointerGetDatum(hi);
+}
+
+/*
+ * Rewrites every stored value that has the given newly registered HRP inline into its registered form, since the inline form
+ * would not compare equal to the registered form of the same address. Such values exist if addresses with the HRP were stored
+ * before it was registered, as happens when a plain dump restores tables that hold addresses before the registry. Every table
+ * with a column of type bitcoin_address (or of a domain over it) is locked against writes until the registering transaction
+ * ends, and each column is searched for the two byte ranges that inline values of the HRP can occupy, which takes two index
+ * probes if the column has a B-tree index but a sequential scan otherwise. Rewritten rows fire the tables' update triggers.
+ * Values nested in arrays or composite types are not rewritten.
+ */
+static void
+repack_inline_values(const char *hrp, Oid nsp_oid)
+{
+	static const char columns_query[] =
+		"WITH RECURSIVE types AS ("
+		"  SELECT oid FROM pg_catalog.pg_type WHERE typname = 'bitcoin_address' AND typnamespace = $1"
+		"  UNION SELECT t.oid FROM pg_catalog.pg_type t JOIN types ON t.typbasetype = types.oid"
+		") "
+		"SELECT c.oid::pg_catalog.regclass::pg_catalog.text, pg_catalog.quote_ident(a.attname::pg_catalog.text), "
+		"pg_catalog.format_type(a.atttypid, a.atttypmod) "
+		"FROM pg_catalog.pg_attribute a JOIN types ON a.atttypid = types.oid "
+		"JOIN pg_catalog.pg_class c ON c.oid = a.attrelid "
+		"WHERE c.relkind IN ('r', 'm') AND c.relispopulated AND a.attnum > 0 AND NOT a.attisdropped AND a.attgenerated = '' "
+		"AND (c.relpersistence <> 't' OR c.relnamespace = pg_catalog.pg_my_temp_schema()) "
+		"ORDER BY c.oid, a.attnum";
+
+	Oid type_oid = GetSysCacheOid2(TYPENAMENSP, Anum_pg_type_oid, CStringGetDatum("bitcoin_address"),
+			ObjectIdGetDatum(nsp_oid));
+	Oid argtypes[] = { type_oid, type_oid };
+	Datum bounds[2][2];
+	inline_hrp_bounds(&bounds[0][0], &bounds[0][1], hrp, false);
+	inline_hrp_bounds(&bounds[1][0], &bounds[1][1], hrp, true);
+
+	// rows hidden by row-level security would silently keep their inline values, so fail instead
+	int save_nestlevel = NewGUCNestLevel();
+	(void) set_config_option("row_security", "off", PGC_USERSET, PGC_S_SESSION, GUC_ACTION_SAVE, true, 0, false);
+
+	SPI_connect();
+	Oid columns_argtypes[] = { OIDOID };
+	Datum columns_args[] = { ObjectIdGetDatum(nsp_oid) };
+	if (SPI_execute_with_args(columns_query, 1, columns_argtypes, columns_args, NULL, true, 0) != SPI_OK_SELECT)
+		elog(ERROR, "could not find the columns of type bitcoin_address");
+	SPITupleTable *columns = SPI_tuptable;
+	uint64 n_columns = SPI_processed;
+	const char *nsp = quote_identifier(get_namespace_name(nsp_oid));
+	for (uint64 i = 0; i < n_columns; ++i) {
+		char *table = SPI_getvalue(columns->vals[i], columns->tupdesc, 1);
+		char *column = SPI_getvalue(columns->vals[i], columns->tupdesc, 2);
+		char *type = SPI_getvalue(columns->vals[i], columns->tupdesc, 3);
+		if (SPI_execute(psprintf("LOCK TABLE %s IN SHARE ROW EXCLUSIVE MODE", table), false, 0) != SPI_OK_UTILITY)
+			elog(ERROR, "could not lock table %s", table);
+		char *update = psprintf("UPDATE %s SET %s = %s::pg_catalog.text::%s WHERE %s OPERATOR(%s.>=) $1 AND %s OPERATOR(%s.<) $2",
+				table, column, column, type, column, nsp, column, nsp);
+		for (size_t j = 0; j < sizeof bounds / sizeof *bounds; ++j)
+			if (SPI_execute_with_args(update, 2, argtypes, bounds[j], NULL, false, 0) != SPI_OK_UPDATE)
+				elog(ERROR, "could not update table %s", table);
+	}
+	SPI_finish();
+
+	AtEOXact_GUC(true, save_nestlevel);
+}
+
+/*
+ * Trigger on the registry table. Registrations are permanent, since stored values refer to them by index, so updates, deletions,
+ * and truncations are refused. After each inserted row, stored values that have its HRP inline are rewritten, and each insertion
+ * statement then broadcasts an invalidation so that every backend rebuilds its mirror.
+ */
+PG_FUNCTION_INFO_V1(pg_bitcoin_address_hrp_registry_trigger);
+Datum
+pg_bitcoin_address_hrp_registry_trigger(PG_FUNCTION_ARGS)
+{
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		ereport(ERROR, errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+				errmsg("function was not called by trigger manager"));
+	const TriggerData *trigdata = (const TriggerData *) fcinfo->context;
+	if (!TRIGGER_FIRED_BY_INSERT(trigdata->tg_event))
+		ereport(ERROR, errcode(ERRCODE_OBJECT_IN_USE),
+				errmsg("registered human-readable prefixes cannot be modified or removed"),
+				errdetail("Stored bitcoin_address values refer to registered prefixes by index."));
+	if (TRIGGER_FIRED_FOR_ROW(trigdata->tg_event)) {
+		bool isnull;
+		Datum hrp = heap_getattr(trigdata->tg_trigtuple, 2, RelationGetDescr(trigdata->tg_relation), &isnull);
+		if (!isnull) {
+			reset_registry(); // so that the rewritten values are packed with the new registration
+			repack_inline_values(TextDatumGetCString(hrp), RelationGetNamespace(trigdata->tg_relation));
+		}
+		PG_RETURN_POINTER(NULL);
+	}
+	CacheInvalidateRelcache(trigdata->tg_relation);
+	PG_RETURN_POINTER(NULL);
+}
@@ -0,0 +1,24 @@
+#include <postgres.h>
+
+#pragma GCC visibility push(hidden)
+
+/*
+ * Well-known HRP indices beyond those of the built-in table are assigned by the bitcoin_address_hrp_registry table. Indices are
+ * never reassigned, so a packed representation that refers to one remains valid for the life of the database. Each backend keeps
+ * a read-only mirror of the table, which is reloaded when the table is modified.
+ */
+#define HRP_REGISTRY_MIN_IDX 7
+#define HRP_REGISTRY_MAX_IDX 62 // 0x80 + 0x40 + 63 would collide with the legacy tag
+
+// registers the invalidation callback; called at module load
+void hrp_registry_init(void);
+
+// returns the registered index of the given HRP (compared case-insensitively), or -1 if it is not registered
+ssize_t hrp_registry_find(const char *hrp, size_t n_hrp)
+	__attribute__ ((__access__ (read_only, 1, 2), __nonnull__));
+
+// returns the lowercase HRP registered at the given index and sets *n_hrp to its length, or returns NULL if none is registered
+const char * hrp_registry_hrp(size_t idx, size_t *n_hrp)
+	__attribute__ ((__access__ (write_only, 2), __nonnull__));
+
+#pragma GCC visibility pop
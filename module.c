@@ -1,4 +1,22 @@
 #include <postgres.h>
 #include <fmgr.h>
 
+#include "bech32_batch.h"
+#include "bip32.h"
+#include "conversion_cache.h"
+#include "hrp_registry.h"
+#include "sha256.h"
+
 PG_MODULE_MAGIC;
+
+void _PG_init(void);
+
+void
+_PG_init(void)
+{
+	bech32_batch_init();
+	sha256_init();
+	conversion_cache_init();
+	hrp_registry_init();
+	bip32_init();
+}
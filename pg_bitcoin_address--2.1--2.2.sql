@@ -0,0 +1,852 @@
+\echo Execute "CREATE EXTENSION pg_bitcoin_address;" to use this extension. \quit
+
+
+--
+-- Encoding/decoding functions
+--
+
+-- The usual 21-byte payloads now have a fixed-size Base58Check codec, so Base58Check costs about as much as Bech32.
+ALTER FUNCTION base58check_encode(bytea) COST 10;
+ALTER FUNCTION base58check_decode(text) COST 10;
+ALTER FUNCTION base58check_input(cstring) COST 10;
+ALTER FUNCTION base58check_output(base58check) COST 10;
+ALTER FUNCTION bitcoin_address_input(cstring) COST 10;
+ALTER FUNCTION bitcoin_address_output(bitcoin_address) COST 10;
+
+CREATE FUNCTION try_base58check_decode(text) RETURNS bytea
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE COST 10
+	AS 'MODULE_PATHNAME', 'pg_try_base58check_decode';
+
+
+CREATE FUNCTION try_bech32_decode(text) RETURNS bit varying
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE COST 10
+	AS 'MODULE_PATHNAME', 'pg_try_bech32_decode';
+
+CREATE FUNCTION try_bech32m_decode(text) RETURNS bit varying
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE COST 10
+	AS 'MODULE_PATHNAME', 'pg_try_bech32m_decode';
+
+
+CREATE FUNCTION try_blech32_decode(text) RETURNS bit varying
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE COST 10
+	AS 'MODULE_PATHNAME', 'pg_try_blech32_decode';
+
+CREATE FUNCTION try_blech32m_decode(text) RETURNS bit varying
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE COST 10
+	AS 'MODULE_PATHNAME', 'pg_try_blech32m_decode';
+
+
+--
+-- Constructor/accessor functions
+--
+
+CREATE FUNCTION try_bitcoin_address(text) RETURNS bitcoin_address
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE COST 10
+	AS 'MODULE_PATHNAME', 'pg_try_bitcoin_address';
+
+
+--
+-- Binary I/O functions
+--
+-- These replace bytearecv/byteasend with functions that prefix a format version byte and validate received values.
+
+CREATE OR REPLACE FUNCTION base58check_receive(internal) RETURNS base58check
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_base58check_receive';
+
+CREATE OR REPLACE FUNCTION base58check_send(base58check) RETURNS bytea
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_base58check_send';
+
+CREATE OR REPLACE FUNCTION bitcoin_address_receive(internal) RETURNS bitcoin_address
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_receive';
+
+CREATE OR REPLACE FUNCTION bitcoin_address_send(bitcoin_address) RETURNS bytea
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_send';
+
+
+--
+-- Classification types and functions
+--
+
+-- The order of the labels must match the C enumerations in bitcoin_address.h.
+CREATE TYPE address_type AS ENUM (
+	'unknown',
+	'p2pkh',
+	'p2sh',
+	'p2wpkh',
+	'p2wsh',
+	'p2tr',
+	'p2pkh_blinded',
+	'p2sh_blinded',
+	'p2wpkh_blinded',
+	'p2wsh_blinded',
+	'p2tr_blinded'
+);
+
+CREATE TYPE address_network AS ENUM (
+	'unknown',
+	'mainnet',
+	'testnet',
+	'regtest',
+	'liquidv1',
+	'liquidtestnet'
+);
+
+CREATE FUNCTION address_type(bitcoin_address) RETURNS address_type
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_type';
+
+CREATE FUNCTION network(bitcoin_address) RETURNS address_network
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_network';
+
+
+--
+-- Script functions
+--
+
+CREATE FUNCTION script_pubkey(address bitcoin_address) RETURNS bytea
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_script_pubkey';
+
+CREATE FUNCTION bitcoin_address_from_script(script bytea, network address_network) RETURNS bitcoin_address
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_from_script';
+
+CREATE FUNCTION electrum_scripthash(address bitcoin_address) RETURNS bytea
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_electrum_scripthash';
+
+
+--
+-- Block functions
+--
+
+CREATE FUNCTION block_outputs(raw_block bytea, network address_network DEFAULT 'mainnet',
+		OUT txid bytea, OUT vout integer, OUT value bigint, OUT address bitcoin_address) RETURNS SETOF record
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE ROWS 5000
+	AS 'MODULE_PATHNAME', 'pg_block_outputs';
+
+
+--
+-- HD key derivation
+--
+
+CREATE FUNCTION derive_addresses(xpub base58check, path text, "from" integer, count integer, type address_type)
+		RETURNS SETOF bitcoin_address
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE ROWS 20
+	AS 'MODULE_PATHNAME', 'pg_derive_addresses';
+
+
+--
+-- Convenience functions
+--
+
+CREATE FUNCTION bitcoin_address_predicate_support(internal) RETURNS internal
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_predicate_support';
+
+CREATE OR REPLACE FUNCTION is_mainnet(address bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE SUPPORT bitcoin_address_predicate_support
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_is_mainnet';
+
+CREATE OR REPLACE FUNCTION is_testnet(address bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE SUPPORT bitcoin_address_predicate_support
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_is_testnet';
+
+CREATE OR REPLACE FUNCTION is_liquidv1(address bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE SUPPORT bitcoin_address_predicate_support
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_is_liquidv1';
+
+CREATE OR REPLACE FUNCTION is_liquidtestnet(address bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE SUPPORT bitcoin_address_predicate_support
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_is_liquidtestnet';
+
+CREATE OR REPLACE FUNCTION is_p2pkh(address bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE SUPPORT bitcoin_address_predicate_support
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_is_p2pkh';
+
+CREATE OR REPLACE FUNCTION is_p2sh(address bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE SUPPORT bitcoin_address_predicate_support
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_is_p2sh';
+
+CREATE OR REPLACE FUNCTION is_p2wpkh(address bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE SUPPORT bitcoin_address_predicate_support
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_is_p2wpkh';
+
+CREATE OR REPLACE FUNCTION is_p2wsh(address bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE SUPPORT bitcoin_address_predicate_support
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_is_p2wsh';
+
+CREATE OR REPLACE FUNCTION is_p2tr(address bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE SUPPORT bitcoin_address_predicate_support
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_is_p2tr';
+
+CREATE OR REPLACE FUNCTION is_blinding(address bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE SUPPORT bitcoin_address_predicate_support
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_is_blinding';
+
+
+--
+-- Statistics
+--
+
+CREATE FUNCTION bitcoin_address_typanalyze(internal) RETURNS boolean
+	LANGUAGE c STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_typanalyze';
+
+ALTER TYPE bitcoin_address SET (ANALYZE = bitcoin_address_typanalyze);
+
+
+--
+-- Type modifiers
+--
+
+CREATE FUNCTION bitcoin_address_typmod_in(cstring[]) RETURNS integer
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_typmod_in';
+
+CREATE FUNCTION bitcoin_address_typmod_out(integer) RETURNS cstring
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_typmod_out';
+
+ALTER TYPE bitcoin_address SET (TYPMOD_IN = bitcoin_address_typmod_in, TYPMOD_OUT = bitcoin_address_typmod_out);
+
+CREATE FUNCTION bitcoin_address_coerce_support(internal) RETURNS internal
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_coerce_support';
+
+CREATE FUNCTION bitcoin_address_coerce(bitcoin_address, integer, boolean) RETURNS bitcoin_address
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE SUPPORT bitcoin_address_coerce_support
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_coerce';
+
+CREATE CAST (bitcoin_address AS bitcoin_address) WITH FUNCTION bitcoin_address_coerce(bitcoin_address, integer, boolean) AS IMPLICIT;
+
+
+--
+-- Array conversion functions
+--
+
+CREATE FUNCTION bitcoin_address_from_text_array(text[]) RETURNS bitcoin_address[]
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE COST 1000
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_from_text_array';
+
+CREATE FUNCTION bitcoin_address_to_text_array(bitcoin_address[]) RETURNS text[]
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE COST 1000
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_to_text_array';
+
+
+--
+-- Conversion cache
+--
+
+CREATE FUNCTION bitcoin_address_conversion_cache_stats(
+		OUT input_hits bigint, OUT input_misses bigint,
+		OUT output_hits bigint, OUT output_misses bigint)
+	LANGUAGE c VOLATILE STRICT PARALLEL RESTRICTED
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_conversion_cache_stats';
+
+
+--
+-- HRP registry
+--
+-- Registered HRPs are stored compactly, by index, like the built-in well-known HRPs. The indices must match the packed
+-- representation in bitcoin_address.h, and registrations are therefore permanent.
+
+CREATE TABLE bitcoin_address_hrp_registry (
+	idx smallint PRIMARY KEY CHECK (idx BETWEEN 7 AND 62),
+	hrp text NOT NULL UNIQUE
+		CHECK (hrp ~ '^[!-~]{1,83}$' AND hrp = lower(hrp) AND hrp NOT IN ('bc', 'tb', 'bcrt', 'ex', 'lq', 'tex', 'tlq'))
+);
+
+SELECT pg_catalog.pg_extension_config_dump('bitcoin_address_hrp_registry', '');
+
+REVOKE ALL ON bitcoin_address_hrp_registry FROM PUBLIC;
+GRANT SELECT ON bitcoin_address_hrp_registry TO PUBLIC;
+
+CREATE FUNCTION bitcoin_address_hrp_registry_trigger() RETURNS trigger
+	LANGUAGE c
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_hrp_registry_trigger';
+
+CREATE TRIGGER bitcoin_address_hrp_registry_repack
+	AFTER INSERT ON bitcoin_address_hrp_registry
+	FOR EACH ROW EXECUTE FUNCTION bitcoin_address_hrp_registry_trigger();
+
+CREATE TRIGGER bitcoin_address_hrp_registry_insert
+	AFTER INSERT ON bitcoin_address_hrp_registry
+	FOR EACH STATEMENT EXECUTE FUNCTION bitcoin_address_hrp_registry_trigger();
+
+CREATE TRIGGER bitcoin_address_hrp_registry_modify
+	BEFORE UPDATE OR DELETE OR TRUNCATE ON bitcoin_address_hrp_registry
+	FOR EACH STATEMENT EXECUTE FUNCTION bitcoin_address_hrp_registry_trigger();
+
+-- locks every table with a bitcoin_address column until commit and rewrites its values that have the HRP inline
+CREATE FUNCTION register_hrp(hrp text) RETURNS integer
+	LANGUAGE sql VOLATILE STRICT
+	AS $$
+		LOCK TABLE @extschema@.bitcoin_address_hrp_registry IN SHARE ROW EXCLUSIVE MODE;
+		INSERT INTO @extschema@.bitcoin_address_hrp_registry (idx, hrp)
+			SELECT coalesce(max(idx) + 1, 7), lower($1) FROM @extschema@.bitcoin_address_hrp_registry
+			RETURNING idx::integer;
+	$$;
+
+REVOKE EXECUTE ON FUNCTION register_hrp(text) FROM PUBLIC;
+
+
+--
+-- Hashing functions
+--
+
+CREATE FUNCTION base58check_hash(base58check) RETURNS integer
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_base58check_hash';
+
+CREATE FUNCTION base58check_hash_extended(base58check, bigint) RETURNS bigint
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_base58check_hash_extended';
+
+
+CREATE FUNCTION bitcoin_address_hash(bitcoin_address) RETURNS integer
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_hash';
+
+CREATE FUNCTION bitcoin_address_hash_extended(bitcoin_address, bigint) RETURNS bigint
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_hash_extended';
+
+
+--
+-- Distinct-count sketches
+--
+
+CREATE TYPE address_hll;
+
+CREATE FUNCTION address_hll_input(cstring) RETURNS address_hll
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_hll_input';
+
+CREATE FUNCTION address_hll_output(address_hll) RETURNS cstring
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_hll_output';
+
+CREATE FUNCTION address_hll_receive(internal) RETURNS address_hll
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_hll_receive';
+
+CREATE FUNCTION address_hll_send(address_hll) RETURNS bytea
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_hll_send';
+
+CREATE TYPE address_hll (
+	INPUT = address_hll_input,
+	OUTPUT = address_hll_output,
+	RECEIVE = address_hll_receive,
+	SEND = address_hll_send,
+	LIKE = bytea,
+	STORAGE = extended
+);
+
+CREATE FUNCTION cardinality(address_hll) RETURNS bigint
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_hll_cardinality';
+
+CREATE FUNCTION bitcoin_address_hll_add(internal, bitcoin_address) RETURNS internal
+	LANGUAGE c IMMUTABLE PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_hll_add';
+
+CREATE FUNCTION address_hll_union_add(internal, address_hll) RETURNS internal
+	LANGUAGE c IMMUTABLE PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_hll_union_add';
+
+CREATE FUNCTION address_hll_combine(internal, internal) RETURNS internal
+	LANGUAGE c IMMUTABLE PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_hll_combine';
+
+CREATE FUNCTION address_hll_serialize(internal) RETURNS bytea
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_hll_serialize';
+
+CREATE FUNCTION address_hll_deserialize(bytea, internal) RETURNS internal
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_hll_deserialize';
+
+CREATE FUNCTION address_hll_final(internal) RETURNS address_hll
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_hll_final';
+
+CREATE FUNCTION address_hll_final_cardinality(internal) RETURNS bigint
+	LANGUAGE c IMMUTABLE PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_hll_final_cardinality';
+
+CREATE AGGREGATE approx_count_distinct(bitcoin_address) (
+	SFUNC = bitcoin_address_hll_add,
+	STYPE = internal,
+	FINALFUNC = address_hll_final_cardinality,
+	COMBINEFUNC = address_hll_combine,
+	SERIALFUNC = address_hll_serialize,
+	DESERIALFUNC = address_hll_deserialize,
+	PARALLEL = SAFE
+);
+
+CREATE AGGREGATE address_hll_agg(bitcoin_address) (
+	SFUNC = bitcoin_address_hll_add,
+	STYPE = internal,
+	FINALFUNC = address_hll_final,
+	COMBINEFUNC = address_hll_combine,
+	SERIALFUNC = address_hll_serialize,
+	DESERIALFUNC = address_hll_deserialize,
+	PARALLEL = SAFE
+);
+
+CREATE AGGREGATE address_hll_union(address_hll) (
+	SFUNC = address_hll_union_add,
+	STYPE = internal,
+	FINALFUNC = address_hll_final,
+	COMBINEFUNC = address_hll_combine,
+	SERIALFUNC = address_hll_serialize,
+	DESERIALFUNC = address_hll_deserialize,
+	PARALLEL = SAFE
+);
+
+
+--
+-- Bloom filters
+--
+
+CREATE TYPE address_bloom;
+
+CREATE FUNCTION address_bloom_input(cstring) RETURNS address_bloom
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_bloom_input';
+
+CREATE FUNCTION address_bloom_output(address_bloom) RETURNS cstring
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_bloom_output';
+
+CREATE FUNCTION address_bloom_receive(internal) RETURNS address_bloom
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_bloom_receive';
+
+CREATE FUNCTION address_bloom_send(address_bloom) RETURNS bytea
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_bloom_send';
+
+CREATE TYPE address_bloom (
+	INPUT = address_bloom_input,
+	OUTPUT = address_bloom_output,
+	RECEIVE = address_bloom_receive,
+	SEND = address_bloom_send,
+	LIKE = bytea,
+	STORAGE = external
+);
+
+CREATE FUNCTION bloom_may_contain(filter address_bloom, address bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bloom_may_contain';
+
+CREATE FUNCTION address_bloom_add(internal, bitcoin_address, double precision) RETURNS internal
+	LANGUAGE c IMMUTABLE PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_bloom_add';
+
+CREATE FUNCTION address_bloom_combine(internal, internal) RETURNS internal
+	LANGUAGE c IMMUTABLE PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_bloom_combine';
+
+CREATE FUNCTION address_bloom_serialize(internal) RETURNS bytea
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_bloom_serialize';
+
+CREATE FUNCTION address_bloom_deserialize(bytea, internal) RETURNS internal
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_bloom_deserialize';
+
+CREATE FUNCTION address_bloom_final(internal) RETURNS address_bloom
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_address_bloom_final';
+
+CREATE AGGREGATE address_bloom(bitcoin_address, double precision) (
+	SFUNC = address_bloom_add,
+	STYPE = internal,
+	FINALFUNC = address_bloom_final,
+	COMBINEFUNC = address_bloom_combine,
+	SERIALFUNC = address_bloom_serialize,
+	DESERIALFUNC = address_bloom_deserialize,
+	PARALLEL = SAFE
+);
+
+
+--
+-- BIP158 compact block filters
+--
+
+CREATE FUNCTION bip158_filter_add_address(internal, bitcoin_address, bytea) RETURNS internal
+	LANGUAGE c IMMUTABLE PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bip158_filter_add_address';
+
+CREATE FUNCTION bip158_filter_add_script(internal, bytea, bytea) RETURNS internal
+	LANGUAGE c IMMUTABLE PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bip158_filter_add_script';
+
+CREATE FUNCTION bip158_filter_combine(internal, internal) RETURNS internal
+	LANGUAGE c IMMUTABLE PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bip158_filter_combine';
+
+CREATE FUNCTION bip158_filter_serialize(internal) RETURNS bytea
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bip158_filter_serialize';
+
+CREATE FUNCTION bip158_filter_deserialize(bytea, internal) RETURNS internal
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bip158_filter_deserialize';
+
+CREATE FUNCTION bip158_filter_final(internal) RETURNS bytea
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bip158_filter_final';
+
+CREATE AGGREGATE bip158_filter(address bitcoin_address, block_hash bytea) (
+	SFUNC = bip158_filter_add_address,
+	STYPE = internal,
+	FINALFUNC = bip158_filter_final,
+	FINALFUNC_MODIFY = READ_WRITE,
+	COMBINEFUNC = bip158_filter_combine,
+	SERIALFUNC = bip158_filter_serialize,
+	DESERIALFUNC = bip158_filter_deserialize,
+	PARALLEL = SAFE
+);
+
+CREATE AGGREGATE bip158_filter(script bytea, block_hash bytea) (
+	SFUNC = bip158_filter_add_script,
+	STYPE = internal,
+	FINALFUNC = bip158_filter_final,
+	FINALFUNC_MODIFY = READ_WRITE,
+	COMBINEFUNC = bip158_filter_combine,
+	SERIALFUNC = bip158_filter_serialize,
+	DESERIALFUNC = bip158_filter_deserialize,
+	PARALLEL = SAFE
+);
+
+CREATE FUNCTION gcs_match_any(filter bytea, block_hash bytea, addresses bitcoin_address[]) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_gcs_match_any';
+
+
+--
+-- Sort support functions
+--
+
+CREATE FUNCTION bitcoin_address_sortsupport(internal) RETURNS void
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_sortsupport';
+
+
+--
+-- Prefix search functions
+--
+
+CREATE FUNCTION bitcoin_address_pattern_cmp(bitcoin_address, bitcoin_address) RETURNS integer
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_pattern_cmp';
+
+CREATE FUNCTION bitcoin_address_pattern_lt(bitcoin_address, bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_pattern_lt';
+
+CREATE FUNCTION bitcoin_address_pattern_le(bitcoin_address, bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_pattern_le';
+
+CREATE FUNCTION bitcoin_address_pattern_ge(bitcoin_address, bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_pattern_ge';
+
+CREATE FUNCTION bitcoin_address_pattern_gt(bitcoin_address, bitcoin_address) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_pattern_gt';
+
+CREATE FUNCTION bitcoin_address_pattern_sortsupport(internal) RETURNS void
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_pattern_sortsupport';
+
+CREATE FUNCTION bitcoin_address_text_pattern_cmp(bitcoin_address, text) RETURNS integer
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_text_pattern_cmp';
+
+CREATE FUNCTION bitcoin_address_text_pattern_lt(bitcoin_address, text) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_text_pattern_lt';
+
+CREATE FUNCTION bitcoin_address_text_pattern_le(bitcoin_address, text) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_text_pattern_le';
+
+CREATE FUNCTION bitcoin_address_text_pattern_eq(bitcoin_address, text) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_text_pattern_eq';
+
+CREATE FUNCTION bitcoin_address_text_pattern_ge(bitcoin_address, text) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_text_pattern_ge';
+
+CREATE FUNCTION bitcoin_address_text_pattern_gt(bitcoin_address, text) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_text_pattern_gt';
+
+CREATE FUNCTION bitcoin_address_starts_with_support(internal) RETURNS internal
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_starts_with_support';
+
+CREATE FUNCTION starts_with(bitcoin_address, text) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE SUPPORT bitcoin_address_starts_with_support
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_starts_with';
+
+
+--
+-- SP-GiST support functions
+--
+
+CREATE FUNCTION program_starts_with(bitcoin_address, bytea) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_program_starts_with';
+
+CREATE FUNCTION bitcoin_address_spgist_config(internal, internal) RETURNS void
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_spgist_config';
+
+CREATE FUNCTION bitcoin_address_spgist_choose(internal, internal) RETURNS void
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_spgist_choose';
+
+CREATE FUNCTION bitcoin_address_spgist_picksplit(internal, internal) RETURNS void
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_spgist_picksplit';
+
+CREATE FUNCTION bitcoin_address_spgist_inner_consistent(internal, internal) RETURNS void
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_spgist_inner_consistent';
+
+CREATE FUNCTION bitcoin_address_spgist_leaf_consistent(internal, internal) RETURNS boolean
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_bitcoin_address_spgist_leaf_consistent';
+
+
+--
+-- BRIN support functions
+--
+
+CREATE FUNCTION base58check_brin_minmax_multi_distance(internal, internal) RETURNS double precision
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_brin_minmax_multi_distance_bytes';
+
+CREATE FUNCTION bitcoin_address_brin_minmax_multi_distance(internal, internal) RETURNS double precision
+	LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE
+	AS 'MODULE_PATHNAME', 'pg_brin_minmax_multi_distance_bytes';
+
+
+--
+-- Operators
+--
+
+ALTER OPERATOR = (base58check, base58check) SET (RESTRICT = eqsel, JOIN = eqjoinsel);
+ALTER OPERATOR <> (base58check, base58check) SET (RESTRICT = neqsel, JOIN = neqjoinsel);
+
+ALTER OPERATOR = (bitcoin_address, bitcoin_address) SET (RESTRICT = eqsel, JOIN = eqjoinsel);
+ALTER OPERATOR <> (bitcoin_address, bitcoin_address) SET (RESTRICT = neqsel, JOIN = neqjoinsel);
+
+-- ALTER OPERATOR cannot set HASHES or MERGES before PostgreSQL 17.
+UPDATE pg_catalog.pg_operator SET oprcanhash = TRUE, oprcanmerge = TRUE
+	WHERE oid IN ('=(base58check, base58check)'::regoperator, '=(bitcoin_address, bitcoin_address)'::regoperator);
+
+CREATE OPERATOR CLASS base58check_hash_ops DEFAULT FOR TYPE base58check
+	USING hash AS
+	OPERATOR 1 =,
+	FUNCTION 1 base58check_hash(base58check),
+	FUNCTION 2 base58check_hash_extended(base58check, bigint);
+
+CREATE OPERATOR CLASS bitcoin_address_hash_ops DEFAULT FOR TYPE bitcoin_address
+	USING hash AS
+	OPERATOR 1 =,
+	FUNCTION 1 bitcoin_address_hash(bitcoin_address),
+	FUNCTION 2 bitcoin_address_hash_extended(bitcoin_address, bigint);
+
+-- Both types are equal-image, so B-tree deduplication is safe.
+ALTER OPERATOR FAMILY base58check_ops USING btree ADD
+	FUNCTION 4 (base58check, base58check) btequalimage(oid);
+
+ALTER OPERATOR FAMILY bitcoin_address_ops USING btree ADD
+	FUNCTION 2 (bitcoin_address, bitcoin_address) bitcoin_address_sortsupport(internal),
+	FUNCTION 4 (bitcoin_address, bitcoin_address) btequalimage(oid);
+
+CREATE OPERATOR CLASS base58check_bloom_ops FOR TYPE base58check
+	USING brin AS
+	OPERATOR 1 =,
+	FUNCTION 1 brin_bloom_opcinfo(internal),
+	FUNCTION 2 brin_bloom_add_value(internal, internal, internal, internal),
+	FUNCTION 3 brin_bloom_consistent(internal, internal, internal, integer),
+	FUNCTION 4 brin_bloom_union(internal, internal, internal),
+	FUNCTION 5 brin_bloom_options(internal),
+	FUNCTION 11 base58check_hash(base58check);
+
+CREATE OPERATOR CLASS base58check_minmax_multi_ops FOR TYPE base58check
+	USING brin AS
+	OPERATOR 1 <,
+	OPERATOR 2 <=,
+	OPERATOR 3 =,
+	OPERATOR 4 >=,
+	OPERATOR 5 >,
+	FUNCTION 1 brin_minmax_multi_opcinfo(internal),
+	FUNCTION 2 brin_minmax_multi_add_value(internal, internal, internal, internal),
+	FUNCTION 3 brin_minmax_multi_consistent(internal, internal, internal, integer),
+	FUNCTION 4 brin_minmax_multi_union(internal, internal, internal),
+	FUNCTION 5 brin_minmax_multi_options(internal),
+	FUNCTION 11 base58check_brin_minmax_multi_distance(internal, internal);
+
+CREATE OPERATOR CLASS bitcoin_address_bloom_ops FOR TYPE bitcoin_address
+	USING brin AS
+	OPERATOR 1 =,
+	FUNCTION 1 brin_bloom_opcinfo(internal),
+	FUNCTION 2 brin_bloom_add_value(internal, internal, internal, internal),
+	FUNCTION 3 brin_bloom_consistent(internal, internal, internal, integer),
+	FUNCTION 4 brin_bloom_union(internal, internal, internal),
+	FUNCTION 5 brin_bloom_options(internal),
+	FUNCTION 11 bitcoin_address_hash(bitcoin_address);
+
+CREATE OPERATOR CLASS bitcoin_address_minmax_multi_ops FOR TYPE bitcoin_address
+	USING brin AS
+	OPERATOR 1 <,
+	OPERATOR 2 <=,
+	OPERATOR 3 =,
+	OPERATOR 4 >=,
+	OPERATOR 5 >,
+	FUNCTION 1 brin_minmax_multi_opcinfo(internal),
+	FUNCTION 2 brin_minmax_multi_add_value(internal, internal, internal, internal),
+	FUNCTION 3 brin_minmax_multi_consistent(internal, internal, internal, integer),
+	FUNCTION 4 brin_minmax_multi_union(internal, internal, internal),
+	FUNCTION 5 brin_minmax_multi_options(internal),
+	FUNCTION 11 bitcoin_address_brin_minmax_multi_distance(internal, internal);
+
+CREATE OPERATOR ~<~ (
+	FUNCTION = bitcoin_address_pattern_lt,
+	LEFTARG = bitcoin_address,
+	RIGHTARG = bitcoin_address,
+	COMMUTATOR = ~>~,
+	NEGATOR = ~>=~,
+	RESTRICT = scalarltsel,
+	JOIN = scalarltjoinsel
+);
+CREATE OPERATOR ~<=~ (
+	FUNCTION = bitcoin_address_pattern_le,
+	LEFTARG = bitcoin_address,
+	RIGHTARG = bitcoin_address,
+	COMMUTATOR = ~>=~,
+	NEGATOR = ~>~,
+	RESTRICT = scalarlesel,
+	JOIN = scalarlejoinsel
+);
+CREATE OPERATOR ~>=~ (
+	FUNCTION = bitcoin_address_pattern_ge,
+	LEFTARG = bitcoin_address,
+	RIGHTARG = bitcoin_address,
+	COMMUTATOR = ~<=~,
+	NEGATOR = ~<~,
+	RESTRICT = scalargesel,
+	JOIN = scalargejoinsel
+);
+CREATE OPERATOR ~>~ (
+	FUNCTION = bitcoin_address_pattern_gt,
+	LEFTARG = bitcoin_address,
+	RIGHTARG = bitcoin_address,
+	COMMUTATOR = ~<~,
+	NEGATOR = ~<=~,
+	RESTRICT = scalargtsel,
+	JOIN = scalargtjoinsel
+);
+
+CREATE OPERATOR ~<~ (
+	FUNCTION = bitcoin_address_text_pattern_lt,
+	LEFTARG = bitcoin_address,
+	RIGHTARG = text,
+	NEGATOR = ~>=~,
+	RESTRICT = scalarltsel,
+	JOIN = scalarltjoinsel
+);
+CREATE OPERATOR ~<=~ (
+	FUNCTION = bitcoin_address_text_pattern_le,
+	LEFTARG = bitcoin_address,
+	RIGHTARG = text,
+	NEGATOR = ~>~,
+	RESTRICT = scalarlesel,
+	JOIN = scalarlejoinsel
+);
+CREATE OPERATOR = (
+	FUNCTION = bitcoin_address_text_pattern_eq,
+	LEFTARG = bitcoin_address,
+	RIGHTARG = text,
+	RESTRICT = eqsel,
+	JOIN = eqjoinsel
+);
+CREATE OPERATOR ~>=~ (
+	FUNCTION = bitcoin_address_text_pattern_ge,
+	LEFTARG = bitcoin_address,
+	RIGHTARG = text,
+	NEGATOR = ~<~,
+	RESTRICT = scalargesel,
+	JOIN = scalargejoinsel
+);
+CREATE OPERATOR ~>~ (
+	FUNCTION = bitcoin_address_text_pattern_gt,
+	LEFTARG = bitcoin_address,
+	RIGHTARG = text,
+	NEGATOR = ~<=~,
+	RESTRICT = scalargtsel,
+	JOIN = scalargtjoinsel
+);
+
+CREATE OPERATOR ^@ (
+	FUNCTION = starts_with,
+	LEFTARG = bitcoin_address,
+	RIGHTARG = text,
+	RESTRICT = matchingsel,
+	JOIN = matchingjoinsel
+);
+
+-- Orders addresses by their textual encodings so that B-tree indexes can answer prefix searches (^@).
+CREATE OPERATOR CLASS bitcoin_address_pattern_ops FOR TYPE bitcoin_address
+	USING btree AS
+	OPERATOR 1 ~<~,
+	OPERATOR 2 ~<=~,
+	OPERATOR 3 =,
+	OPERATOR 4 ~>=~,
+	OPERATOR 5 ~>~,
+	FUNCTION 1 bitcoin_address_pattern_cmp(bitcoin_address, bitcoin_address),
+	FUNCTION 2 bitcoin_address_pattern_sortsupport(internal),
+	FUNCTION 4 btequalimage(oid);
+
+ALTER OPERATOR FAMILY bitcoin_address_pattern_ops USING btree ADD
+	OPERATOR 1 ~<~ (bitcoin_address, text),
+	OPERATOR 2 ~<=~ (bitcoin_address, text),
+	OPERATOR 3 = (bitcoin_address, text),
+	OPERATOR 4 ~>=~ (bitcoin_address, text),
+	OPERATOR 5 ~>~ (bitcoin_address, text),
+	FUNCTION 1 (bitcoin_address, text) bitcoin_address_text_pattern_cmp(bitcoin_address, text);
+
+CREATE OPERATOR ^@ (
+	FUNCTION = program_starts_with,
+	LEFTARG = bitcoin_address,
+	RIGHTARG = bytea,
+	RESTRICT = matchingsel,
+	JOIN = matchingjoinsel
+);
+
+-- A radix tree over the stored bytes, which answers equality and witness-program prefix (^@ bytea) searches.
+CREATE OPERATOR CLASS bitcoin_address_spgist_ops DEFAULT FOR TYPE bitcoin_address
+	USING spgist AS
+	OPERATOR 3 = (bitcoin_address, bitcoin_address),
+	OPERATOR 28 ^@ (bitcoin_address, bytea),
+	FUNCTION 1 bitcoin_address_spgist_config(internal, internal),
+	FUNCTION 2 bitcoin_address_spgist_choose(internal, internal),
+	FUNCTION 3 bitcoin_address_spgist_picksplit(internal, internal),
+	FUNCTION 4 bitcoin_address_spgist_inner_consistent(internal, internal),
+	FUNCTION 5 bitcoin_address_spgist_leaf_consistent(internal, internal);
@@ -0,0 +1,127 @@
+#include <postgres.h>
+
+#include "ripemd160.h"
+#include "sha256.h"
+
+#define RIPEMD160_BLOCK_SIZE 64
+
+
+// message word selection, rotation amounts, and constants of the left and right lines
+static const uint8 ripemd160_r[2][80] = {
+	{
+		0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+		7, 4, 13, 1, 10, 6, 15, 3, 12, 0, 9, 5, 2, 14, 11, 8,
+		3, 10, 14, 4, 9, 15, 8, 1, 2, 7, 0, 6, 13, 11, 5, 12,
+		1, 9, 11, 10, 0, 8, 12, 4, 13, 3, 7, 15, 14, 5, 6, 2,
+		4, 0, 5, 9, 7, 12, 2, 10, 14, 1, 3, 8, 11, 6, 15, 13,
+	},
+	{
+		5, 14, 7, 0, 9, 2, 11, 4, 13, 6, 15, 8, 1, 10, 3, 12,
+		6, 11, 3, 7, 0, 13, 5, 10, 14, 15, 8, 12, 4, 9, 1, 2,
+		15, 5, 1, 3, 7, 14, 6, 9, 11, 8, 12, 2, 10, 0, 4, 13,
+		8, 6, 4, 1, 3, 11, 15, 0, 5, 12, 2, 13, 9, 7, 10, 14,
+		12, 15, 10, 4, 1, 5, 8, 7, 6, 2, 13, 14, 0, 3, 9, 11,
+	},
+};
+
+static const uint8 ripemd160_s[2][80] = {
+	{
+		11, 14, 15, 12, 5, 8, 7, 9, 11, 13, 14, 15, 6, 7, 9, 8,
+		7, 6, 8, 13, 11, 9, 7, 15, 7, 12, 15, 9, 11, 7, 13, 12,
+		11, 13, 6, 7, 14, 9, 13, 15, 14, 8, 13, 6, 5, 12, 7, 5,
+		11, 12, 14, 15, 14, 15, 9, 8, 9, 14, 5, 6, 8, 6, 5, 12,
+		9, 15, 5, 11, 6, 8, 13, 12, 5, 12, 13, 14, 11, 8, 5, 6,
+	},
+	{
+		8, 9, 9, 11, 13, 15, 15, 5, 7, 7, 8, 11, 14, 14, 12, 6,
+		9, 13, 15, 7, 12, 8, 9, 11, 7, 7, 12, 7, 6, 15, 13, 11,
+		9, 7, 15, 11, 8, 6, 6, 14, 12, 13, 5, 14, 13, 13, 7, 5,
+		15, 5, 8, 11, 14, 14, 6, 14, 6, 9, 12, 9, 12, 5, 15, 8,
+		8, 5, 12, 9, 12, 5, 14, 6, 8, 13, 6, 5, 15, 13, 11, 11,
+	},
+};
+
+static const uint32 ripemd160_k[2][5] = {
+	{ 0x00000000, 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xA953FD4E },
+	{ 0x50A28BE6, 0x5C4DD124, 0x6D703EF3, 0x7A6D76E9, 0x00000000 },
+};
+
+static inline uint32 __attribute__ ((__const__))
+rol32(uint32 x, unsigned n)
+{
+	return x << n | x >> (32 - n);
+}
+
+// the boolean function of the given round; the right line applies them in reverse order
+static inline uint32 __attribute__ ((__const__))
+ripemd160_f(size_t round, uint32 x, uint32 y, uint32 z)
+{
+	switch (round) {
+		case 0: return x ^ y ^ z;
+		case 1: return x & y | ~x & z;
+		case 2: return (x | ~y) ^ z;
+		case 3: return x & z | y & ~z;
+		default: return x ^ (y | ~z);
+	}
+}
+
+static void
+ripemd160_transform(uint32 state[5], const uint8 blocks[], size_t n_blocks)
+{
+	for (; n_blocks; --n_blocks, blocks += RIPEMD160_BLOCK_SIZE) {
+		uint32 x[16];
+		for (size_t i = 0; i < 16; ++i)
+			x[i] = (uint32) blocks[i * 4] | (uint32) blocks[i * 4 + 1] << 8 |
+					(uint32) blocks[i * 4 + 2] << 16 | (uint32) blocks[i * 4 + 3] << 24;
+
+		uint32 v[2][5];
+		memcpy(v[0], state, sizeof v[0]);
+		memcpy(v[1], state, sizeof v[1]);
+		for (size_t line = 0; line < 2; ++line)
+			for (size_t j = 0; j < 80; ++j) {
+				size_t round = j / 16;
+				uint32 *a = v[line];
+				uint32 t = rol32(a[0] + ripemd160_f(line ? 4 - round : round, a[1], a[2], a[3]) + x[ripemd160_r[line][j]] +
+						ripemd160_k[line][round], ripemd160_s[line][j]) + a[4];
+				a[0] = a[4], a[4] = a[3], a[3] = rol32(a[2], 10), a[2] = a[1], a[1] = t;
+			}
+		uint32 t = state[1] + v[0][2] + v[1][3];
+		state[1] = state[2] + v[0][3] + v[1][4];
+		state[2] = state[3] + v[0][4] + v[1][0];
+		state[3] = state[4] + v[0][0] + v[1][1];
+		state[4] = state[0] + v[0][1] + v[1][2];
+		state[0] = t;
+	}
+}
+
+void
+ripemd160(uint8 out[RIPEMD160_DIGEST_SIZE], const uint8 in[], size_t n_in)
+{
+	uint32 state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+	size_t n_left = n_in;
+	for (; n_left >= RIPEMD160_BLOCK_SIZE; in += RIPEMD160_BLOCK_SIZE, n_left -= RIPEMD160_BLOCK_SIZE)
+		ripemd160_transform(state, in, 1);
+
+	// pad the final one or two blocks with a 1 bit, zeros, and the 64-bit message length in bits, least significant byte first
+	uint8 tail[RIPEMD160_BLOCK_SIZE * 2] = { 0 };
+	if (n_left) memcpy(tail, in, n_left);
+	tail[n_left] = 0x80;
+	size_t n_tail = n_left + 1 + sizeof(uint64) > RIPEMD160_BLOCK_SIZE ? RIPEMD160_BLOCK_SIZE * 2 : RIPEMD160_BLOCK_SIZE;
+	uint64 nbits = (uint64) n_in * BITS_PER_BYTE;
+	for (size_t i = 0; i < sizeof nbits; ++i)
+		tail[n_tail - sizeof nbits + i] = (uint8) (nbits >> (8 * i));
+	ripemd160_transform(state, tail, n_tail / RIPEMD160_BLOCK_SIZE);
+
+	for (size_t i = 0; i < 5; ++i)
+		for (size_t j = 0; j < 4; ++j)
+			out[i * 4 + j] = (uint8) (state[i] >> (8 * j));
+}
+
+void
+hash160(uint8 out[RIPEMD160_DIGEST_SIZE], const uint8 in[], size_t n_in)
+{
+	uint8 digest[SHA256_DIGEST_SIZE];
+	sha256(digest, in, n_in);
+	ripemd160(out, digest, sizeof digest);
+}
@@ -0,0 +1,14 @@
+#include <postgres.h>
+
+#pragma GCC visibility push(hidden)
+
+#define RIPEMD160_DIGEST_SIZE 20
+
+void ripemd160(uint8 out[RIPEMD160_DIGEST_SIZE], const uint8 in[], size_t n_in)
+	__attribute__ ((__access__ (write_only, 1), __access__ (read_only, 2, 3), __nonnull__ (1), __nothrow__));
+
+// computes RIPEMD-160(SHA-256(in)), the hash of keys and scripts in legacy and version 0 witness addresses
+void hash160(uint8 out[RIPEMD160_DIGEST_SIZE], const uint8 in[], size_t n_in)
+	__attribute__ ((__access__ (write_only, 1), __access__ (read_only, 2, 3), __nonnull__ (1), __nothrow__));
+
+#pragma GCC visibility pop
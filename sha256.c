@@ -0,0 +1,312 @@
+#include <postgres.h>
+#include <port/pg_bswap.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "sha256.h"
+
+#define SHA256_BLOCK_SIZE 64
+
+
+static const uint32 sha256_k[64] = {
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+static const uint32 sha256_h0[8] = {
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+static inline uint32 __attribute__ ((__const__))
+ror32(uint32 x, unsigned n)
+{
+	return x >> n | x << (32 - n);
+}
+
+static void
+sha256_transform_generic(uint32 state[8], const uint8 blocks[], size_t n_blocks)
+{
+	for (; n_blocks; --n_blocks, blocks += SHA256_BLOCK_SIZE) {
+		uint32 w[64];
+		for (size_t i = 0; i < 16; ++i) {
+			uint32 word;
+			memcpy(&word, &blocks[i * 4], sizeof word);
+			w[i] = pg_ntoh32(word);
+		}
+		for (size_t i = 16; i < 64; ++i)
+			w[i] = w[i - 16] + (ror32(w[i - 15], 7) ^ ror32(w[i - 15], 18) ^ w[i - 15] >> 3) +
+					w[i - 7] + (ror32(w[i - 2], 17) ^ ror32(w[i - 2], 19) ^ w[i - 2] >> 10);
+
+		uint32 a = state[0], b = state[1], c = state[2], d = state[3],
+			e = state[4], f = state[5], g = state[6], h = state[7];
+		for (size_t i = 0; i < 64; ++i) {
+			uint32 t1 = h + (ror32(e, 6) ^ ror32(e, 11) ^ ror32(e, 25)) + (e & f ^ ~e & g) + sha256_k[i] + w[i],
+				t2 = (ror32(a, 2) ^ ror32(a, 13) ^ ror32(a, 22)) + (a & b ^ a & c ^ b & c);
+			h = g, g = f, f = e, e = d + t1;
+			d = c, c = b, b = a, a = t1 + t2;
+		}
+		state[0] += a, state[1] += b, state[2] += c, state[3] += d;
+		state[4] += e, state[5] += f, state[6] += g, state[7] += h;
+	}
+}
+
+/*
+ * A lanes kernel applies the compression function to n independent single-block messages, each with its own chaining state,
+ * processing LANES messages in parallel in the lanes of a GCC generic vector. The compiler maps the vector operations onto the
+ * registers of the target instruction set. Lanes beyond the end of the input in the final group compute garbage that is discarded.
+ */
+#define DEFINE_SHA256_LANES_KERNEL(name, attributes, LANES) \
+	static void attributes \
+	name(uint32 states[][8], const uint8 *const blocks[], size_t n) \
+	{ \
+		typedef uint32 vec __attribute__ ((__vector_size__ (LANES * sizeof(uint32)))); \
+	\
+		for (size_t base = 0; base < n; base += LANES) { \
+			size_t n_lanes = Min(LANES, n - base); \
+	\
+			vec w[64], s[8]; \
+			for (size_t i = 0; i < 16; ++i) \
+				for (size_t lane = 0; lane < LANES; ++lane) { \
+					uint32 word = 0; \
+					if (lane < n_lanes) \
+						memcpy(&word, &blocks[base + lane][i * 4], sizeof word); \
+					w[i][lane] = pg_ntoh32(word); \
+				} \
+			for (size_t j = 0; j < 8; ++j) \
+				for (size_t lane = 0; lane < LANES; ++lane) \
+					s[j][lane] = lane < n_lanes ? states[base + lane][j] : 0; \
+	\
+			for (size_t i = 16; i < 64; ++i) \
+				w[i] = w[i - 16] + ((w[i - 15] >> 7 | w[i - 15] << 25) ^ (w[i - 15] >> 18 | w[i - 15] << 14) ^ w[i - 15] >> 3) + \
+						w[i - 7] + ((w[i - 2] >> 17 | w[i - 2] << 15) ^ (w[i - 2] >> 19 | w[i - 2] << 13) ^ w[i - 2] >> 10); \
+			vec a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7]; \
+			for (size_t i = 0; i < 64; ++i) { \
+				vec t1 = h + ((e >> 6 | e << 26) ^ (e >> 11 | e << 21) ^ (e >> 25 | e << 7)) + (e & f ^ ~e & g) + sha256_k[i] + w[i], \
+					t2 = ((a >> 2 | a << 30) ^ (a >> 13 | a << 19) ^ (a >> 22 | a << 10)) + (a & b ^ a & c ^ b & c); \
+				h = g, g = f, f = e, e = d + t1; \
+				d = c, c = b, b = a, a = t1 + t2; \
+			} \
+			s[0] += a, s[1] += b, s[2] += c, s[3] += d, s[4] += e, s[5] += f, s[6] += g, s[7] += h; \
+	\
+			for (size_t lane = 0; lane < n_lanes; ++lane) \
+				for (size_t j = 0; j < 8; ++j) \
+					states[base + lane][j] = s[j][lane]; \
+		} \
+	}
+
+DEFINE_SHA256_LANES_KERNEL(sha256_lanes_generic, , 4)
+
+#if defined(__x86_64__) || defined(__i386__)
+
+DEFINE_SHA256_LANES_KERNEL(sha256_lanes_avx2, __attribute__ ((__target__ ("avx2"))), 8)
+
+/*
+ * The SHA extensions keep the state in two registers as (A, B, E, F) and (C, D, G, H), and each SHA256RNDS2 instruction performs
+ * two rounds. The message schedule is computed four words at a time with SHA256MSG1 and SHA256MSG2 in a rolling window of four
+ * registers.
+ */
+static void __attribute__ ((__target__ ("sha,sse4.1")))
+sha256_transform_shani(uint32 state[8], const uint8 blocks[], size_t n_blocks)
+{
+	const __m128i bswap_mask = _mm_set_epi64x(0x0C0D0E0F08090A0B, 0x0405060700010203);
+
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[0]), 0xB1), // CDAB
+		state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[4]), 0x1B), // EFGH
+		state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0); // CDGH
+
+	for (; n_blocks; --n_blocks, blocks += SHA256_BLOCK_SIZE) {
+		__m128i abef = state0, cdgh = state1, msg[4];
+#pragma GCC unroll 16
+		for (size_t i = 0; i < 16; ++i) {
+			if (i < 4)
+				msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) &blocks[i * 16]), bswap_mask);
+			else
+				msg[i % 4] = _mm_sha256msg2_epu32(
+						_mm_add_epi32(_mm_sha256msg1_epu32(msg[i % 4], msg[(i + 1) % 4]),
+								_mm_alignr_epi8(msg[(i + 3) % 4], msg[(i + 2) % 4], 4)),
+						msg[(i + 3) % 4]);
+			__m128i wk = _mm_add_epi32(msg[i % 4], _mm_loadu_si128((const __m128i *) &sha256_k[i * 4]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+		}
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B); // FEBA
+	state1 = _mm_shuffle_epi32(state1, 0xB1); // DCHG
+	_mm_storeu_si128((__m128i *) &state[0], _mm_blend_epi16(tmp, state1, 0xF0)); // DCBA
+	_mm_storeu_si128((__m128i *) &state[4], _mm_alignr_epi8(state1, tmp, 8)); // HGFE
+}
+
+#endif
+
+/*
+ * The transform used for single messages and the kernel used for batches are selected by sha256_init at module load. Where the
+ * SHA extensions are available, a single stream of SHA256RNDS2 instructions outpaces the multi-lane kernels, so batches are
+ * simply hashed one block after another.
+ */
+static void (*sha256_transform)(uint32 [8], const uint8 [], size_t) = &sha256_transform_generic;
+static void (*sha256_lanes)(uint32 [][8], const uint8 *const [], size_t) = &sha256_lanes_generic;
+
+static void
+sha256_lanes_serial(uint32 states[][8], const uint8 *const blocks[], size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		(*sha256_transform)(states[i], blocks[i], 1);
+}
+
+void
+sha256_init(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1"))
+		sha256_transform = &sha256_transform_shani, sha256_lanes = &sha256_lanes_serial;
+	else if (__builtin_cpu_supports("avx2"))
+		sha256_lanes = &sha256_lanes_avx2;
+#endif
+}
+
+static void
+store_digest(uint8 out[SHA256_DIGEST_SIZE], const uint32 state[8])
+{
+	for (size_t i = 0; i < 8; ++i) {
+		uint32 word = pg_hton32(state[i]);
+		memcpy(&out[i * 4], &word, sizeof word);
+	}
+}
+
+void
+sha256(uint8 out[SHA256_DIGEST_SIZE], const uint8 in[], size_t n_in)
+{
+	uint32 state[8];
+	memcpy(state, sha256_h0, sizeof state);
+
+	size_t n_left = n_in;
+	for (; n_left >= SHA256_BLOCK_SIZE; in += SHA256_BLOCK_SIZE, n_left -= SHA256_BLOCK_SIZE)
+		(*sha256_transform)(state, in, 1);
+
+	// pad the final one or two blocks with a 1 bit, zeros, and the 64-bit message length in bits
+	uint8 tail[SHA256_BLOCK_SIZE * 2] = { 0 };
+	if (n_left) memcpy(tail, in, n_left);
+	tail[n_left] = 0x80;
+	size_t n_tail = n_left + 1 + sizeof(uint64) > SHA256_BLOCK_SIZE ? SHA256_BLOCK_SIZE * 2 : SHA256_BLOCK_SIZE;
+	uint64 nbits = pg_hton64((uint64) n_in * BITS_PER_BYTE);
+	memcpy(&tail[n_tail - sizeof nbits], &nbits, sizeof nbits);
+	(*sha256_transform)(state, tail, n_tail / SHA256_BLOCK_SIZE);
+
+	store_digest(out, state);
+}
+
+void
+sha256d(uint8 out[SHA256_DIGEST_SIZE], const uint8 in[], size_t n_in)
+{
+	uint8 digest[SHA256_DIGEST_SIZE];
+	sha256(digest, in, n_in);
+	sha256(out, digest, sizeof digest);
+}
+
+StaticAssertDecl(sizeof ((struct sha256_ctx *) NULL)->buffer == SHA256_BLOCK_SIZE, "sha256_ctx buffer must hold one block");
+
+void
+sha256_begin(struct sha256_ctx *ctx)
+{
+	memcpy(ctx->state, sha256_h0, sizeof ctx->state);
+	ctx->n_total = 0;
+}
+
+void
+sha256_update(struct sha256_ctx *ctx, const uint8 in[], size_t n_in)
+{
+	size_t n_buffered = ctx->n_total % SHA256_BLOCK_SIZE;
+	ctx->n_total += n_in;
+	if (n_buffered) {
+		size_t n = Min(n_in, SHA256_BLOCK_SIZE - n_buffered);
+		memcpy(&ctx->buffer[n_buffered], in, n);
+		in += n, n_in -= n;
+		if (n_buffered + n < SHA256_BLOCK_SIZE)
+			return;
+		(*sha256_transform)(ctx->state, ctx->buffer, 1);
+	}
+	if (n_in >= SHA256_BLOCK_SIZE) {
+		(*sha256_transform)(ctx->state, in, n_in / SHA256_BLOCK_SIZE);
+		in += n_in / SHA256_BLOCK_SIZE * SHA256_BLOCK_SIZE, n_in %= SHA256_BLOCK_SIZE;
+	}
+	if (n_in)
+		memcpy(ctx->buffer, in, n_in);
+}
+
+void
+sha256_end(struct sha256_ctx *ctx, uint8 out[SHA256_DIGEST_SIZE])
+{
+	size_t n_left = ctx->n_total % SHA256_BLOCK_SIZE;
+	uint8 tail[SHA256_BLOCK_SIZE * 2] = { 0 };
+	if (n_left) memcpy(tail, ctx->buffer, n_left);
+	tail[n_left] = 0x80;
+	size_t n_tail = n_left + 1 + sizeof(uint64) > SHA256_BLOCK_SIZE ? SHA256_BLOCK_SIZE * 2 : SHA256_BLOCK_SIZE;
+	uint64 nbits = pg_hton64(ctx->n_total * BITS_PER_BYTE);
+	memcpy(&tail[n_tail - sizeof nbits], &nbits, sizeof nbits);
+	(*sha256_transform)(ctx->state, tail, n_tail / SHA256_BLOCK_SIZE);
+	store_digest(out, ctx->state);
+}
+
+/*
+ * Pads a message of at most SHA256_SINGLE_BLOCK_MAX_SIZE bytes into a single block.
+ */
+static void
+pad_single_block(uint8 block[SHA256_BLOCK_SIZE], const uint8 in[], size_t n_in)
+{
+	memcpy(block, in, n_in);
+	block[n_in] = 0x80;
+	memset(&block[n_in + 1], 0, SHA256_BLOCK_SIZE - sizeof(uint64) - n_in - 1);
+	uint64 nbits = pg_hton64((uint64) n_in * BITS_PER_BYTE);
+	memcpy(&block[SHA256_BLOCK_SIZE - sizeof nbits], &nbits, sizeof nbits);
+}
+
+void
+sha256d_batch(uint8 out[][SHA256_DIGEST_SIZE], const uint8 *const in[], size_t n_in, size_t n)
+{
+	if (n_in > SHA256_SINGLE_BLOCK_MAX_SIZE) {
+		for (size_t i = 0; i < n; ++i)
+			sha256d(out[i], in[i], n_in);
+		return;
+	}
+
+	// the messages are hashed in chunks so that the working set stays in the L1 cache
+	enum { CHUNK = 64 };
+	uint32 states[CHUNK][8];
+	uint8 blocks[CHUNK][SHA256_BLOCK_SIZE];
+	const uint8 *block_ptrs[CHUNK];
+	for (size_t i = 0; i < CHUNK; ++i)
+		block_ptrs[i] = blocks[i];
+
+	for (size_t base = 0; base < n; base += CHUNK) {
+		size_t n_chunk = Min(CHUNK, n - base);
+		for (size_t i = 0; i < n_chunk; ++i) {
+			memcpy(states[i], sha256_h0, sizeof *states);
+			pad_single_block(blocks[i], in[base + i], n_in);
+		}
+		(*sha256_lanes)(states, block_ptrs, n_chunk);
+
+		for (size_t i = 0; i < n_chunk; ++i) {
+			uint8 digest[SHA256_DIGEST_SIZE];
+			store_digest(digest, states[i]);
+			memcpy(states[i], sha256_h0, sizeof *states);
+			pad_single_block(blocks[i], digest, sizeof digest);
+		}
+		(*sha256_lanes)(states, block_ptrs, n_chunk);
+
+		for (size_t i = 0; i < n_chunk; ++i)
+			store_digest(out[base + i], states[i]);
+	}
+}
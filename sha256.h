@@ -0,0 +1,40 @@
+#include <postgres.h>
+
+#pragma GCC visibility push(hidden)
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_SINGLE_BLOCK_MAX_SIZE 55 // longest message that pads into a single block
+
+// selects the fastest implementation that the CPU supports; called at module load
+void sha256_init(void);
+
+void sha256(uint8 out[SHA256_DIGEST_SIZE], const uint8 in[], size_t n_in)
+	__attribute__ ((__access__ (write_only, 1), __access__ (read_only, 2, 3), __nonnull__ (1), __nothrow__));
+
+void sha256d(uint8 out[SHA256_DIGEST_SIZE], const uint8 in[], size_t n_in)
+	__attribute__ ((__access__ (write_only, 1), __access__ (read_only, 2, 3), __nonnull__ (1), __nothrow__));
+
+// state of an incremental hash, for messages that are not contiguous in memory
+struct sha256_ctx {
+	uint32 state[8];
+	uint64 n_total;
+	uint8 buffer[64];
+};
+
+void sha256_begin(struct sha256_ctx *ctx)
+	__attribute__ ((__access__ (write_only, 1), __nonnull__, __nothrow__));
+
+void sha256_update(struct sha256_ctx *ctx, const uint8 in[], size_t n_in)
+	__attribute__ ((__access__ (read_write, 1), __access__ (read_only, 2, 3), __nonnull__ (1), __nothrow__));
+
+void sha256_end(struct sha256_ctx *ctx, uint8 out[SHA256_DIGEST_SIZE])
+	__attribute__ ((__access__ (read_write, 1), __access__ (write_only, 2), __nonnull__, __nothrow__));
+
+/*
+ * Computes the double SHA-256 digests of n messages of n_in bytes each. Messages that fit in a single block are hashed several at
+ * a time in SIMD lanes.
+ */
+void sha256d_batch(uint8 out[][SHA256_DIGEST_SIZE], const uint8 *const in[], size_t n_in, size_t n)
+	__attribute__ ((__access__ (write_only, 1, 4), __access__ (read_only, 2, 4), __nothrow__));
+
+#pragma GCC visibility pop
@@ -0,0 +1,124 @@
+#include <postgres.h>
+#include <port/pg_bswap.h>
+
+#include "sha512.h"
+
+#define SHA512_BLOCK_SIZE 128
+
+
+static const uint64 sha512_k[80] = {
+	UINT64CONST(0x428A2F98D728AE22), UINT64CONST(0x7137449123EF65CD), UINT64CONST(0xB5C0FBCFEC4D3B2F), UINT64CONST(0xE9B5DBA58189DBBC),
+	UINT64CONST(0x3956C25BF348B538), UINT64CONST(0x59F111F1B605D019), UINT64CONST(0x923F82A4AF194F9B), UINT64CONST(0xAB1C5ED5DA6D8118),
+	UINT64CONST(0xD807AA98A3030242), UINT64CONST(0x12835B0145706FBE), UINT64CONST(0x243185BE4EE4B28C), UINT64CONST(0x550C7DC3D5FFB4E2),
+	UINT64CONST(0x72BE5D74F27B896F), UINT64CONST(0x80DEB1FE3B1696B1), UINT64CONST(0x9BDC06A725C71235), UINT64CONST(0xC19BF174CF692694),
+	UINT64CONST(0xE49B69C19EF14AD2), UINT64CONST(0xEFBE4786384F25E3), UINT64CONST(0x0FC19DC68B8CD5B5), UINT64CONST(0x240CA1CC77AC9C65),
+	UINT64CONST(0x2DE92C6F592B0275), UINT64CONST(0x4A7484AA6EA6E483), UINT64CONST(0x5CB0A9DCBD41FBD4), UINT64CONST(0x76F988DA831153B5),
+	UINT64CONST(0x983E5152EE66DFAB), UINT64CONST(0xA831C66D2DB43210), UINT64CONST(0xB00327C898FB213F), UINT64CONST(0xBF597FC7BEEF0EE4),
+	UINT64CONST(0xC6E00BF33DA88FC2), UINT64CONST(0xD5A79147930AA725), UINT64CONST(0x06CA6351E003826F), UINT64CONST(0x142929670A0E6E70),
+	UINT64CONST(0x27B70A8546D22FFC), UINT64CONST(0x2E1B21385C26C926), UINT64CONST(0x4D2C6DFC5AC42AED), UINT64CONST(0x53380D139D95B3DF),
+	UINT64CONST(0x650A73548BAF63DE), UINT64CONST(0x766A0ABB3C77B2A8), UINT64CONST(0x81C2C92E47EDAEE6), UINT64CONST(0x92722C851482353B),
+	UINT64CONST(0xA2BFE8A14CF10364), UINT64CONST(0xA81A664BBC423001), UINT64CONST(0xC24B8B70D0F89791), UINT64CONST(0xC76C51A30654BE30),
+	UINT64CONST(0xD192E819D6EF5218), UINT64CONST(0xD69906245565A910), UINT64CONST(0xF40E35855771202A), UINT64CONST(0x106AA07032BBD1B8),
+	UINT64CONST(0x19A4C116B8D2D0C8), UINT64CONST(0x1E376C085141AB53), UINT64CONST(0x2748774CDF8EEB99), UINT64CONST(0x34B0BCB5E19B48A8),
+	UINT64CONST(0x391C0CB3C5C95A63), UINT64CONST(0x4ED8AA4AE3418ACB), UINT64CONST(0x5B9CCA4F7763E373), UINT64CONST(0x682E6FF3D6B2B8A3),
+	UINT64CONST(0x748F82EE5DEFB2FC), UINT64CONST(0x78A5636F43172F60), UINT64CONST(0x84C87814A1F0AB72), UINT64CONST(0x8CC702081A6439EC),
+	UINT64CONST(0x90BEFFFA23631E28), UINT64CONST(0xA4506CEBDE82BDE9), UINT64CONST(0xBEF9A3F7B2C67915), UINT64CONST(0xC67178F2E372532B),
+	UINT64CONST(0xCA273ECEEA26619C), UINT64CONST(0xD186B8C721C0C207), UINT64CONST(0xEADA7DD6CDE0EB1E), UINT64CONST(0xF57D4F7FEE6ED178),
+	UINT64CONST(0x06F067AA72176FBA), UINT64CONST(0x0A637DC5A2C898A6), UINT64CONST(0x113F9804BEF90DAE), UINT64CONST(0x1B710B35131C471B),
+	UINT64CONST(0x28DB77F523047D84), UINT64CONST(0x32CAAB7B40C72493), UINT64CONST(0x3C9EBE0A15C9BEBC), UINT64CONST(0x431D67C49C100D4C),
+	UINT64CONST(0x4CC5D4BECB3E42B6), UINT64CONST(0x597F299CFC657E2A), UINT64CONST(0x5FCB6FAB3AD6FAEC), UINT64CONST(0x6C44198C4A475817),
+};
+
+static const uint64 sha512_h0[8] = {
+	UINT64CONST(0x6A09E667F3BCC908), UINT64CONST(0xBB67AE8584CAA73B), UINT64CONST(0x3C6EF372FE94F82B), UINT64CONST(0xA54FF53A5F1D36F1),
+	UINT64CONST(0x510E527FADE682D1), UINT64CONST(0x9B05688C2B3E6C1F), UINT64CONST(0x1F83D9ABFB41BD6B), UINT64CONST(0x5BE0CD19137E2179),
+};
+
+static inline uint64 __attribute__ ((__const__))
+ror64(uint64 x, unsigned n)
+{
+	return x >> n | x << (64 - n);
+}
+
+static void
+sha512_transform(uint64 state[8], const uint8 blocks[], size_t n_blocks)
+{
+	for (; n_blocks; --n_blocks, blocks += SHA512_BLOCK_SIZE) {
+		uint64 w[80];
+		for (size_t i = 0; i < 16; ++i) {
+			uint64 word;
+			memcpy(&word, &blocks[i * 8], sizeof word);
+			w[i] = pg_ntoh64(word);
+		}
+		for (size_t i = 16; i < 80; ++i)
+			w[i] = w[i - 16] + (ror64(w[i - 15], 1) ^ ror64(w[i - 15], 8) ^ w[i - 15] >> 7) +
+					w[i - 7] + (ror64(w[i - 2], 19) ^ ror64(w[i - 2], 61) ^ w[i - 2] >> 6);
+
+		uint64 a = state[0], b = state[1], c = state[2], d = state[3],
+			e = state[4], f = state[5], g = state[6], h = state[7];
+		for (size_t i = 0; i < 80; ++i) {
+			uint64 t1 = h + (ror64(e, 14) ^ ror64(e, 18) ^ ror64(e, 41)) + (e & f ^ ~e & g) + sha512_k[i] + w[i],
+				t2 = (ror64(a, 28) ^ ror64(a, 34) ^ ror64(a, 39)) + (a & b ^ a & c ^ b & c);
+			h = g, g = f, f = e, e = d + t1;
+			d = c, c = b, b = a, a = t1 + t2;
+		}
+		state[0] += a, state[1] += b, state[2] += c, state[3] += d;
+		state[4] += e, state[5] += f, state[6] += g, state[7] += h;
+	}
+}
+
+// hashes the remainder of a message whose first n_prior bytes have been compressed into state, and stores the digest
+static void
+sha512_finish(uint8 out[SHA512_DIGEST_SIZE], uint64 state[8], size_t n_prior, const uint8 in[], size_t n_in)
+{
+	size_t n_total = n_prior + n_in;
+	for (; n_in >= SHA512_BLOCK_SIZE; in += SHA512_BLOCK_SIZE, n_in -= SHA512_BLOCK_SIZE)
+		sha512_transform(state, in, 1);
+
+	// pad the final one or two blocks with a 1 bit, zeros, and the 128-bit message length in bits
+	uint8 tail[SHA512_BLOCK_SIZE * 2] = { 0 };
+	if (n_in) memcpy(tail, in, n_in);
+	tail[n_in] = 0x80;
+	size_t n_tail = n_in + 1 + 2 * sizeof(uint64) > SHA512_BLOCK_SIZE ? SHA512_BLOCK_SIZE * 2 : SHA512_BLOCK_SIZE;
+	uint64 nbits = pg_hton64((uint64) n_total * BITS_PER_BYTE);
+	memcpy(&tail[n_tail - sizeof nbits], &nbits, sizeof nbits);
+	sha512_transform(state, tail, n_tail / SHA512_BLOCK_SIZE);
+
+	for (size_t i = 0; i < 8; ++i) {
+		uint64 word = pg_hton64(state[i]);
+		memcpy(&out[i * 8], &word, sizeof word);
+	}
+}
+
+void
+hmac_sha512_init(struct hmac_sha512_key *key, const uint8 in[], size_t n_in)
+{
+	uint8 block[SHA512_BLOCK_SIZE] = { 0 };
+	if (n_in > SHA512_BLOCK_SIZE) {
+		uint64 state[8];
+		memcpy(state, sha512_h0, sizeof state);
+		sha512_finish(block, state, 0, in, n_in);
+	}
+	else if (n_in)
+		memcpy(block, in, n_in);
+
+	for (size_t i = 0; i < SHA512_BLOCK_SIZE; ++i)
+		block[i] ^= 0x36;
+	memcpy(key->inner, sha512_h0, sizeof key->inner);
+	sha512_transform(key->inner, block, 1);
+	for (size_t i = 0; i < SHA512_BLOCK_SIZE; ++i)
+		block[i] ^= 0x36 ^ 0x5C;
+	memcpy(key->outer, sha512_h0, sizeof key->outer);
+	sha512_transform(key->outer, block, 1);
+}
+
+void
+hmac_sha512(uint8 out[SHA512_DIGEST_SIZE], const struct hmac_sha512_key *key, const uint8 in[], size_t n_in)
+{
+	uint64 state[8];
+	uint8 digest[SHA512_DIGEST_SIZE];
+	memcpy(state, key->inner, sizeof state);
+	sha512_finish(digest, state, SHA512_BLOCK_SIZE, in, n_in);
+	memcpy(state, key->outer, sizeof state);
+	sha512_finish(out, state, SHA512_BLOCK_SIZE, digest, sizeof digest);
+}
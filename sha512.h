@@ -0,0 +1,18 @@
+#include <postgres.h>
+
+#pragma GCC visibility push(hidden)
+
+#define SHA512_DIGEST_SIZE 64
+
+// an HMAC-SHA-512 key, held as the chaining states after its inner and outer padded blocks
+struct hmac_sha512_key {
+	uint64 inner[8], outer[8];
+};
+
+void hmac_sha512_init(struct hmac_sha512_key *key, const uint8 in[], size_t n_in)
+	__attribute__ ((__access__ (write_only, 1), __access__ (read_only, 2, 3), __nonnull__ (1), __nothrow__));
+
+void hmac_sha512(uint8 out[SHA512_DIGEST_SIZE], const struct hmac_sha512_key *key, const uint8 in[], size_t n_in)
+	__attribute__ ((__access__ (write_only, 1), __access__ (read_only, 2), __access__ (read_only, 3, 4), __nonnull__ (1, 2), __nothrow__));
+
+#pragma GCC visibility pop
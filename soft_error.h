@@ -0,0 +1,29 @@
+#pragma once
+
+#include <postgres.h>
+
+/*
+ * PostgreSQL 16 introduced soft error reporting, which allows input functions to report invalid input to a caller-supplied
+ * ErrorSaveContext instead of throwing. On older versions, the server never supplies one, so soft errors degrade to ordinary errors
+ * in input functions, but the try_ functions still supply their own and so return NULL for invalid input on every version.
+ */
+#if PG_VERSION_NUM >= 160000
+# include <nodes/miscnodes.h>
+#else
+# include <nodes/nodes.h>
+typedef struct ErrorSaveContext {
+	NodeTag type;
+	bool error_occurred;
+} ErrorSaveContext;
+# define T_ErrorSaveContext T_Invalid // never the tag of a context supplied by the server
+# define errsave(context, ...) do { \
+		Node *errsave_context_ = (Node *) (context); \
+		if (errsave_context_ && IsA(errsave_context_, ErrorSaveContext)) \
+			((ErrorSaveContext *) errsave_context_)->error_occurred = true; \
+		else \
+			ereport(ERROR, __VA_ARGS__); \
+	} while (0)
+# define ereturn(context, dummy_value, ...) do { errsave(context, __VA_ARGS__); return dummy_value; } while (0)
+# define SOFT_ERROR_OCCURRED(escontext) \
+	((escontext) != NULL && IsA(escontext, ErrorSaveContext) && ((ErrorSaveContext *) (escontext))->error_occurred)
+#endif